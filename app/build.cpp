@@ -62,7 +62,8 @@ void Build::addArgs()
     m_ap.add(
             "--dataType",
             "Data type for serialized point cloud data.  Valid values are "
-            "\"laszip\", \"zstandard\", or \"binary\".  Default: \"laszip\".\n"
+            "\"laszip\", \"zstandard\", \"columnar\", or \"binary\".  "
+            "Default: \"laszip\".\n"
             "Example: --dataType binary",
             [this](json j) { m_json["dataType"] = j; });
 
@@ -160,12 +161,81 @@ void Build::addArgs()
             "output.",
             [this](json j) { m_json["cacheSize"] = extract(j); });
 
+    m_ap.add(
+            "--maxMemory",
+            "Memory budget in megabytes for held nodes, a quarter of which "
+            "holds serialized nodes awaiting output.  Recently-unused "
+            "nodes are serialized to stay within it.  If set, this takes "
+            "precedence over --cacheSize.",
+            [this](json j) { m_json["maxMemory"] = extract(j); });
+
+    m_ap.add(
+            "--hugePages",
+            "Request transparent huge pages for point data memory, which "
+            "may reduce TLB misses for large builds.  Linux only.",
+            [this](json j) { checkEmpty(j); m_json["hugePages"] = true; });
+
+    m_ap.add(
+            "--schedule",
+            "Order in which to insert the input files: \"manifest\" "
+            "(default) to insert them in input order, \"hilbert\" to insert "
+            "spatially nearby files together, or \"largest\" to insert the "
+            "files with the most points first.",
+            [this](json j) { m_json["schedule"] = extract(j); });
+
     m_ap.add(
             "--hierarchyStep",
             "Hierarchy step size - recommended to be set for testing only as "
             "entwine will determine it heuristically.",
             [this](json j) { m_json["hierarchyStep"] = extract(j); });
 
+    m_ap.add(
+            "--uploadThreads",
+            "Threads with which to write nodes to the output, separate from "
+            "the threads which encode them (default: 8).",
+            [this](json j) { m_json["uploadThreads"] = extract(j); });
+
+    m_ap.add(
+            "--uploadQueueSize",
+            "Number of encoded nodes which may wait to be written to the "
+            "output before encoding blocks (default: 16).",
+            [this](json j) { m_json["uploadQueueSize"] = extract(j); });
+
+    m_ap.add(
+            "--zstdLevel",
+            "Compression level for the zstandard data type (default: 3).",
+            [this](json j) { m_json["zstdLevel"] = extract(j); });
+
+    m_ap.add(
+            "--zstdLong",
+            "Enable long-distance matching for the zstandard data type.",
+            [this](json j) { checkEmpty(j); m_json["zstdLong"] = true; });
+
+    m_ap.add(
+            "--zstdThreads",
+            "Worker threads with which to compress each node for the "
+            "zstandard data type.  Only nodes large enough to be split "
+            "among them will use them (default: 0).",
+            [this](json j) { m_json["zstdThreads"] = extract(j); });
+
+    m_ap.add(
+            "--zstdDictionary",
+            "Train a dictionary with which to compress every node for the "
+            "zstandard data type, which shrinks small nodes.  The dictionary "
+            "is written to the output, and is needed to read the data.",
+            [this](json j)
+            {
+                checkEmpty(j);
+                m_json["zstdDictionary"] = true;
+            });
+
+    m_ap.add(
+            "--zstdShuffle",
+            "Shuffle the bytes of each node by dimension, and delta code "
+            "XYZ and GpsTime, before compressing it for the zstandard data "
+            "type.",
+            [this](json j) { checkEmpty(j); m_json["zstdShuffle"] = true; });
+
     m_ap.add(
             "--sleepCount",
             "Count (per-thread) after which idle nodes are serialized.",
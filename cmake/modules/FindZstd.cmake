@@ -1,3 +1,5 @@
+include(FindPackageHandleStandardArgs)
+
 find_path(ZSTD_INCLUDE_DIR NAMES zstd.h)
 find_library(ZSTD_LIBRARY NAMES zstd)
 
@@ -27,6 +27,7 @@ function(compiler_options target)
             ${PDAL_INCLUDE_DIRS}
             ${CURL_INCLUDE_DIR}
             ${OPENSSL_INCLUDE_DIR}
+            ${ZSTD_INCLUDE_DIRS}
             ${LASZIP_DIRECTORIES}
 			${JSONCPP_INCLUDE_DIR}
     )
@@ -0,0 +1,4 @@
+find_package(Zstd)
+if (NOT ZSTD_FOUND)
+    message(FATAL_ERROR "Zstandard (libzstd) is required")
+endif()
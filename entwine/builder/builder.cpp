@@ -12,23 +12,113 @@
 
 #include <algorithm>
 #include <cassert>
+#include <cctype>
 
-#include <pdal/PipelineManager.hpp>
+#include <pdal/pdal_features.hpp>
 
 #include <entwine/builder/clipper.hpp>
 #include <entwine/builder/heuristics.hpp>
+#include <entwine/builder/insert-batch.hpp>
+#include <entwine/builder/schedule.hpp>
 #include <entwine/types/dimension.hpp>
-#include <entwine/types/point-counts.hpp>
+#include <entwine/types/record.hpp>
 #include <entwine/util/config.hpp>
 #include <entwine/util/fs.hpp>
 #include <entwine/util/io.hpp>
 #include <entwine/util/pdal-mutex.hpp>
 #include <entwine/util/pipeline.hpp>
+#include <entwine/util/pipeline-template.hpp>
+#include <entwine/util/slab-pool.hpp>
+#include <entwine/util/spin-lock.hpp>
 #include <entwine/util/time.hpp>
+#include <entwine/util/unique.hpp>
 
 namespace entwine
 {
 
+namespace
+{
+
+// Older versions of readers.las lack the "start" option, and reject it.
+#if PDAL_VERSION_MAJOR > 2 || \
+    (PDAL_VERSION_MAJOR == 2 && PDAL_VERSION_MINOR >= 3)
+const bool canSeekLas = true;
+#else
+const bool canSeekLas = false;
+#endif
+
+// Splitting a source into point ranges relies on the reader's ability to seek
+// to a starting point, and on every filter in the pipeline passing each point
+// through on its own, without dropping any.  Then the PointIds of each slice,
+// numbered from its starting point, match those of an unsplit insertion.
+bool isSplittable(const BuildItem& item)
+{
+    if (!canSeekLas) return false;
+
+    const json& pipeline = item.source.info.pipeline;
+    if (!pipeline.is_null() && !pipeline.is_array()) return false;
+
+    const StringList pointwise = {
+        "filters.assign",
+        "filters.ferry",
+        "filters.reprojection",
+        "filters.stats"
+    };
+
+    for (uint64_t i = 1; i < pipeline.size(); ++i)
+    {
+        const json& stage = pipeline.at(i);
+        if (!stage.is_object()) return false;
+
+        const std::string type = stage.value("type", "");
+        if (std::find(pointwise.begin(), pointwise.end(), type) ==
+            pointwise.end())
+        {
+            return false;
+        }
+    }
+
+    const json reader = pipeline.size() ? pipeline.at(0) : json::object();
+    if (!reader.is_object()) return false;
+    if (reader.count("type"))
+    {
+        return reader.at("type").get<std::string>() == "readers.las";
+    }
+
+    std::string extension = arbiter::getExtension(item.source.path);
+    std::transform(
+        extension.begin(),
+        extension.end(),
+        extension.begin(),
+        [](unsigned char c) { return std::tolower(c); });
+    return extension == "las" || extension == "laz";
+}
+
+// The pipeline for inserting this item, which is shared among all items of
+// the same format with the same pipeline.
+json getPipeline(const BuildItem& item)
+{
+    const SourceInfo& info = item.source.info;
+    json pipeline = info.pipeline.is_null()
+        ? json::array({ json::object() })
+        : info.pipeline;
+
+    // TODO: Allow this to be set via config.
+    const bool needsStats = !hasStats(info.schema);
+    if (needsStats)
+    {
+        json& statsFilter = findOrAppendStage(pipeline, "filters.stats");
+        if (!statsFilter.count("enumerate"))
+        {
+            statsFilter.update({ { "enumerate", "Classification" } });
+        }
+    }
+
+    return toTemplate(pipeline, item.source.path);
+}
+
+} // unnamed namespace
+
 Builder::Builder(
     Endpoints endpoints,
     Metadata metadata,
@@ -69,43 +159,159 @@ void Builder::runInserts(
         )
         : metadata.boundsConforming;
 
+    OriginList origins;
+    for (
+        uint64_t origin = 0;
+        origin < manifest.size() && (!limit || origins.size() < limit);
+        ++origin)
+    {
+        const auto& item = manifest.at(origin);
+        const auto& info = item.source.info;
+        if (!item.inserted && info.points && active.overlaps(info.bounds))
+        {
+            origins.push_back(origin);
+        }
+    }
+
+    schedule::apply(metadata.internal.schedule, manifest, active, origins);
+
+    // If we have fewer sources than work threads, split the large ones into
+    // point ranges so that all of our work threads have something to do.
+    const uint64_t desiredSlices = origins.empty()
+        ? 1
+        : std::max<uint64_t>(
+            1,
+            (threads.work + origins.size() - 1) / origins.size());
+
+    // Most builds have a single distinct pipeline, so we only need to parse
+    // and validate it once rather than once per file.
+    std::map<std::string, std::shared_ptr<const PipelineTemplate>> templates;
+
+    std::vector<std::unique_ptr<SplitSource>> sources;
+    uint64_t totalSlices = 0;
+    for (const Origin origin : origins)
+    {
+        auto& item = manifest.at(origin);
+
+        std::shared_ptr<const PipelineTemplate> pipeline;
+        try
+        {
+            const json j = getPipeline(item);
+            const std::string key = j.dump();
+            if (!templates.count(key))
+            {
+                templates[key] = std::make_shared<PipelineTemplate>(j);
+            }
+            pipeline = templates.at(key);
+        }
+        catch (const std::exception& e)
+        {
+            item.source.info.errors.push_back(e.what());
+            item.inserted = true;
+            continue;
+        }
+
+        const uint64_t slices = isSplittable(item)
+            ? std::max<uint64_t>(
+                1,
+                std::min<uint64_t>(
+                    desiredSlices,
+                    item.source.info.points / heuristics::minPointsPerSlice))
+            : 1;
+
+        sources.push_back(makeUnique<SplitSource>(origin, slices, pipeline));
+        totalSlices += slices;
+    }
+
     const uint64_t actualWorkThreads =
-        std::min<uint64_t>(threads.work, manifest.size());
+        std::min<uint64_t>(threads.work, totalSlices);
     const uint64_t stolenThreads = threads.work - actualWorkThreads;
     const uint64_t actualClipThreads = threads.clip + stolenThreads;
 
-    ChunkCache cache(endpoints, metadata, hierarchy, actualClipThreads);
-    Pool pool(std::min<uint64_t>(actualWorkThreads, manifest.size()));
+    SlabPool::get().setHugePages(metadata.internal.hugePages);
 
-    uint64_t filesInserted = 0;
+    ChunkCache cache(endpoints, metadata, hierarchy, actualClipThreads);
+    ClipperPool clippers(cache, actualWorkThreads);
+    Pool pool(actualWorkThreads);
 
-    for (
-        uint64_t origin = 0;
-        origin < manifest.size() && (!limit || filesInserted < limit);
-        ++origin)
+    for (auto& s : sources)
     {
+        SplitSource& source = *s;
+        const Origin origin = source.origin;
         const auto& item = manifest.at(origin);
-        const auto& info = item.source.info;
-        if (!item.inserted && info.points && active.overlaps(info.bounds))
+
+        std::cout << "Adding " << origin << " - " << item.source.path;
+        if (source.remaining > 1)
+        {
+            std::cout << " (" << source.remaining << " slices)";
+        }
+        std::cout << std::endl;
+
+        // The last slice absorbs any remainder.
+        const uint64_t points = item.source.info.points;
+        const uint64_t slices = source.remaining;
+        const uint64_t perSlice = points / slices;
+
+        for (uint64_t i = 0; i < slices; ++i)
         {
-            std::cout << "Adding " << origin << " - " << item.source.path <<
-                std::endl;
+            const uint64_t start = slices > 1 ? i * perSlice : 0;
+            const uint64_t count = slices > 1 && i + 1 < slices ? perSlice : 0;
 
-            pool.add([this, &cache, origin, &counter]()
+            pool.add([&, this, start, count]()
             {
-                tryInsert(cache, origin, counter);
-                std::cout << "\tDone " << origin << std::endl;
+                std::unique_ptr<Clipper> clipper(clippers.acquire());
+                tryInsert(cache, *clipper, source, start, count, counter);
+                clippers.release(std::move(clipper));
             });
-
-            ++filesInserted;
         }
     }
 
     std::cout << "Joining" << std::endl;
 
     pool.join();
+    clippers.clear();
     cache.join();
 
+    const ChunkCache::Info cacheInfo(ChunkCache::totalInfo());
+    const uint64_t accesses(cacheInfo.hits + cacheInfo.reloads);
+    std::cout << "Chunk cache (" << toString(metadata.internal.schedule) <<
+        " schedule): " <<
+        commify(cacheInfo.hits) << " hits, " <<
+        commify(cacheInfo.reloads) << " reloads";
+    if (accesses)
+    {
+        std::cout << " - " <<
+            std::round(100.0 * cacheInfo.hits / accesses) << "% hit rate";
+    }
+    std::cout << std::endl;
+
+    const PdalMutex::Info pdalInfo(PdalMutex::info());
+    std::cout << "PDAL lock: " <<
+        commify(pdalInfo.acquired) << " acquired, " <<
+        commify(pdalInfo.contended) << " contended, " <<
+        pdalInfo.waitedUs / 1000 << " ms waiting" << std::endl;
+
+    const SlabPool::Info slabInfo(SlabPool::get().info());
+    std::cout << "Point memory: " <<
+        commify(slabInfo.outstanding / 1024 / 1024) << " MB outstanding, " <<
+        commify(slabInfo.free / 1024 / 1024) << " MB free, " <<
+        commify(slabInfo.reserved / 1024 / 1024) << " MB reserved" <<
+        std::endl;
+
+    // All point storage is free now that the cache has been joined, so hand
+    // it back to the system rather than holding it for the life of the
+    // process.
+    SlabPool::get().trim();
+
+    for (const LockSite::Info& lock : locks::info())
+    {
+        if (!lock.contended) continue;
+        std::cout << "Lock " << lock.name << ": " <<
+            commify(lock.contended) << " contended, " <<
+            commify(lock.parked) << " parked, " <<
+            lock.waitedUs / 1000 << " ms waiting" << std::endl;
+    }
+
     save(getTotal(threads));
 }
 
@@ -154,127 +360,157 @@ void Builder::monitor(
             "(" << commify(intervalPace) << ") M/h - " <<
             info.written << "W - " <<
             info.read << "R - " <<
-            info.alive << "A" <<
-            std::endl;
+            info.alive << "A";
+
+        // Resident bytes per point, and how much of that is indexing on top
+        // of the records themselves.
+        if (info.points)
+        {
+            const uint64_t perPoint = info.bytes / info.points;
+            const uint64_t pointSize = getPointSize(metadata.memorySchema);
+            std::cout << " - " << perPoint << " B/pt (" <<
+                (perPoint > pointSize ? perPoint - pointSize : 0) <<
+                " index)";
+        }
+        std::cout << std::endl;
     }
 }
 
 void Builder::tryInsert(
     ChunkCache& cache,
-    const Origin originId,
+    Clipper& clipper,
+    SplitSource& source,
+    const uint64_t start,
+    const uint64_t count,
     std::atomic_uint64_t& counter)
 {
-    auto& item = manifest.at(originId);
+    auto& item = manifest.at(source.origin);
 
+    std::string error;
     try
     {
-        insert(cache, originId, counter);
+        insert(cache, clipper, source, start, count, counter);
     }
     catch (const std::exception& e)
     {
-        item.source.info.errors.push_back(e.what());
+        error = e.what();
     }
     catch (...)
     {
-        item.source.info.errors.push_back("Unknown error during build");
+        error = "Unknown error during build";
     }
 
+    std::lock_guard<std::mutex> lock(source.mutex);
+    if (error.size()) item.source.info.errors.push_back(error);
+
+    if (--source.remaining) return;
+
+    // This was the final slice for this source - wrap it up.
+    for (Dimension& d : item.source.info.schema)
+    {
+        const auto it = source.stats.find(d.name);
+        if (it != source.stats.end()) d.stats = it->second;
+    }
+
+    source.handle.reset();
     item.inserted = true;
+
+    std::cout << "\tDone " << source.origin << std::endl;
 }
 
 void Builder::insert(
     ChunkCache& cache,
-    const Origin originId,
+    Clipper& clipper,
+    SplitSource& source,
+    const uint64_t start,
+    const uint64_t count,
     std::atomic_uint64_t& counter)
 {
+    const Origin originId = source.origin;
     auto& item = manifest.at(originId);
-    auto& info(item.source.info);
-    const auto handle =
-        ensureGetLocalHandle(*endpoints.arbiter, item.source.path);
+    const auto& info(item.source.info);
 
-    const std::string localPath = handle.localPath();
+    std::string localPath;
+    {
+        // Slices of the same source share a single local copy.
+        std::lock_guard<std::mutex> lock(source.mutex);
+        if (!source.handle)
+        {
+            const auto& a = *endpoints.arbiter;
+            auto handle = ensureGetLocalHandle(a, item.source.path);
+            source.handle = makeUnique<arbiter::LocalHandle>(
+                handle.release(),
+                !a.isLocal(item.source.path));
+        }
+        localPath = source.handle->localPath();
+    }
 
-    ChunkKey ck(metadata.bounds, getStartDepth(metadata));
-    Clipper clipper(cache);
+    ChunkKey ck(metadata.quantizer);
 
     optional<ScaleOffset> so = getScaleOffset(metadata.schema);
     const optional<Bounds> boundsSubset = metadata.subset
         ? getBounds(metadata.bounds, *metadata.subset)
         : optional<Bounds>();
 
-    uint64_t inserted(0);
-    uint64_t pointId(0);
+    uint64_t pointId(start);
+    InsertBatch batch(metadata, originId);
+    std::vector<Pending> pending;
 
     auto layout = toLayout(metadata.absoluteSchema);
     VectorPointTable table(layout);
     table.setProcess([&]()
     {
-        inserted += table.numPoints();
-        if (inserted > heuristics::sleepCount)
+        clipper.inserted(table.numPoints());
+        if (clipper.sinceClip() > metadata.internal.sleepCount)
         {
-            inserted = 0;
             clipper.clip();
+
+            // While we're short of memory, chunks pinned by idle clippers
+            // must age out too, or they can never be evicted.
+            if (clipper.pool() && cache.overMemory()) clipper.pool()->age();
         }
 
-        Voxel voxel;
-        PointCounts counts;
+        pointId += batch.gather(table, pointId);
+        if (so) batch.clip(*so);
+        batch.filter(metadata.boundsConforming);
+        if (boundsSubset) batch.filter(*boundsSubset);
+        batch.quantize(metadata.quantizer);
+        batch.convert();
 
-        Key key(metadata.bounds, getStartDepth(metadata));
+        Voxel voxel;
+        Key key(metadata.quantizer, getStartDepth(metadata));
 
-        for (auto it = table.begin(); it != table.end(); ++it)
+        pending.clear();
+        for (std::size_t i(0); i < batch.size(); ++i)
         {
-            auto& pr = it.pointRef();
-            pr.setField(DimId::OriginId, originId);
-            pr.setField(DimId::PointId, pointId);
-            ++pointId;
-
-            voxel.initShallow(it.pointRef(), it.data());
-            if (so) voxel.clip(*so);
-            const Point& point(voxel.point());
-
-            ck.reset();
-
-            if (metadata.boundsConforming.contains(point))
-            {
-                if (!boundsSubset || boundsSubset->contains(point))
-                {
-                    key.init(point);
-                    cache.insert(voxel, key, ck, clipper);
-                    ++counts.inserts;
-                }
-            }
+            voxel.initShallow(batch.point(i), batch.data(i));
+            key.init(batch.lattice(i));
+            pending.emplace_back(voxel, key);
         }
-        counter += counts.inserts;
-    });
 
-    json pipeline = info.pipeline.is_null()
-        ? json::array({ json::object() })
-        : info.pipeline;
-    pipeline.at(0)["filename"] = localPath;
+        ck.reset();
+        Pending* begin(pending.data());
+        cache.insert(begin, begin + pending.size(), ck, clipper);
+        counter += batch.size();
+    });
 
-    // TODO: Allow this to be set via config.
-    const bool needsStats = !hasStats(info.schema);
-    if (needsStats)
+    // A count of zero means "to the end of the file".
+    pdal::Options readerOptions;
+    if (start || count)
     {
-        json& statsFilter = findOrAppendStage(pipeline, "filters.stats");
-        if (!statsFilter.count("enumerate"))
-        {
-            statsFilter.update({ { "enumerate", "Classification" } });
-        }
+        readerOptions.add("start", start);
+        if (count) readerOptions.add("count", count);
     }
 
-    pdal::PipelineManager pm;
-    std::istringstream iss(pipeline.dump());
-
-    std::unique_lock<std::mutex> lock(PdalMutex::get());
-
-    pm.readPipeline(iss);
-    pm.validateStageOptions();
-    pdal::Stage& last = getStage(pm);
-    last.prepare(table);
-
-    lock.unlock();
-
+    // The template was validated up front, so setting up this file's stages
+    // doesn't require the global PDAL lock - but preparing them does, since
+    // spatial reference setup within prepare is not thread-safe.
+    auto chain = source.pipeline->instantiate(localPath, readerOptions);
+    pdal::Stage& last = chain->last();
+    {
+        PdalGuard lock(PdalMutex::get());
+        last.prepare(table);
+    }
     last.execute(table);
 
     // TODO:
@@ -284,10 +520,15 @@ void Builder::insert(
         const pdal::StatsFilter& statsFilter(
             dynamic_cast<const pdal::StatsFilter&>(*stage));
 
-        for (Dimension& d : info.schema)
+        std::lock_guard<std::mutex> lock(source.mutex);
+        for (const Dimension& d : info.schema)
         {
             const DimId id = layout.findDim(d.name);
-            d.stats = DimensionStats(statsFilter.getStats(id));
+            const DimensionStats stats(statsFilter.getStats(id));
+
+            auto it = source.stats.find(d.name);
+            if (it == source.stats.end()) source.stats[d.name] = stats;
+            else it->second = combine(it->second, stats);
         }
     }
 }
@@ -428,20 +669,21 @@ void merge(Builder& dst, const Builder& src, ChunkCache& cache)
         }
         else
         {
-            auto layout = toLayout(metadata.absoluteSchema);
+            const RecordXyz xyz(metadata.memorySchema);
+            auto layout = toLayout(metadata.memorySchema);
             VectorPointTable table(layout, count);
             table.setProcess([&]()
             {
                 Voxel voxel;
-                Key pk(metadata.bounds, getStartDepth(metadata));
-                ChunkKey ck(metadata.bounds, getStartDepth(metadata));
+                Key pk(metadata.quantizer, getStartDepth(metadata));
+                ChunkKey ck(metadata.quantizer);
 
                 for (auto it(table.begin()); it != table.end(); ++it)
                 {
-                    voxel.initShallow(it.pointRef(), it.data());
-                    const Point point(voxel.point());
-                    pk.init(point, key.d);
-                    ck.init(point, key.d);
+                    voxel.initShallow(xyz.get(it.data()), it.data());
+                    const Xyz l(metadata.quantizer.quantize(voxel.point()));
+                    pk.init(l, key.d);
+                    ck.init(l, key.d);
 
                     assert(ck.dxyz() == key);
 
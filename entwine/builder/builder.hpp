@@ -11,18 +11,47 @@
 #pragma once
 
 #include <atomic>
+#include <memory>
+#include <mutex>
 #include <string>
 
 #include <entwine/builder/chunk-cache.hpp>
+#include <entwine/builder/clipper.hpp>
 #include <entwine/builder/hierarchy.hpp>
 #include <entwine/types/endpoints.hpp>
 #include <entwine/types/metadata.hpp>
 #include <entwine/types/source.hpp>
 #include <entwine/types/threads.hpp>
+#include <entwine/util/pipeline-template.hpp>
 
 namespace entwine
 {
 
+// Large sources may be split into contiguous point ranges, each of which is
+// inserted concurrently by its own work thread with that thread's Clipper.
+// This state is shared by all slices of a single source, so that a remote
+// source is only localized once and its build item is only finalized after
+// every slice has completed.
+struct SplitSource
+{
+    SplitSource(
+        Origin origin,
+        uint64_t slices,
+        std::shared_ptr<const PipelineTemplate> pipeline)
+        : origin(origin)
+        , pipeline(pipeline)
+        , remaining(slices)
+    { }
+
+    const Origin origin;
+    const std::shared_ptr<const PipelineTemplate> pipeline;
+
+    std::mutex mutex;
+    std::unique_ptr<arbiter::LocalHandle> handle;
+    std::map<std::string, DimensionStats> stats;
+    uint64_t remaining = 0;
+};
+
 struct Builder
 {
     Builder(
@@ -47,11 +76,17 @@ struct Builder
         std::atomic_uint64_t& counter);
     void tryInsert(
         ChunkCache& cache,
-        uint64_t origin,
+        Clipper& clipper,
+        SplitSource& source,
+        uint64_t start,
+        uint64_t count,
         std::atomic_uint64_t& counter);
     void insert(
         ChunkCache& cache,
-        uint64_t origin,
+        Clipper& clipper,
+        SplitSource& source,
+        uint64_t start,
+        uint64_t count,
         std::atomic_uint64_t& counter);
     void save(unsigned threads);
 
@@ -10,6 +10,9 @@
 
 #include <entwine/builder/chunk-cache.hpp>
 
+#include <algorithm>
+#include <limits>
+
 #include <entwine/builder/clipper.hpp>
 
 namespace entwine
@@ -19,17 +22,54 @@ namespace
 {
     SpinLock infoSpin;
     ChunkCache::Info info;
+    ChunkCache::Info totals;
+
+    void accumulate(ChunkCache::Info& dst, const ChunkCache::Info& src)
+    {
+        dst.written += src.written;
+        dst.read += src.read;
+        dst.alive = src.alive;
+        dst.hits += src.hits;
+        dst.reloads += src.reloads;
+        dst.bytes += src.bytes;
+        dst.points += src.points;
+    }
+
+    // A quarter of the memory budget, if there is one, holds spilled chunks,
+    // leaving the rest for resident chunks.
+    uint64_t getSpillMemory(const BuildParameters& p)
+    {
+        return p.maxMemory ? p.maxMemory / 4 : heuristics::spillMemory;
+    }
+
+    uint64_t getResidentMemory(const BuildParameters& p)
+    {
+        return p.maxMemory - p.maxMemory / 4;
+    }
 }
 
 ChunkCache::Info ChunkCache::latchInfo()
 {
     SpinGuard lock(infoSpin);
     Info latched = info;
+    accumulate(totals, info);
     info.written = 0;
     info.read = 0;
+    info.hits = 0;
+    info.reloads = 0;
+    info.bytes = 0;
+    info.points = 0;
     return latched;
 }
 
+ChunkCache::Info ChunkCache::totalInfo()
+{
+    SpinGuard lock(infoSpin);
+    Info total = totals;
+    accumulate(total, info);
+    return total;
+}
+
 ChunkCache::ChunkCache(
     const Endpoints& endpoints,
     const Metadata& metadata,
@@ -39,6 +79,14 @@ ChunkCache::ChunkCache(
     , m_metadata(metadata)
     , m_hierarchy(hierarchy)
     , m_pool(threads)
+    , m_cacheSize(
+        metadata.internal.maxMemory
+            ? std::numeric_limits<uint64_t>::max()
+            : metadata.internal.cacheSize)
+    , m_maxMemory(getResidentMemory(metadata.internal))
+    , m_spill(endpoints, metadata, getSpillMemory(metadata.internal))
+    , m_resident(0)
+    , m_tick(0)
 { }
 
 ChunkCache::~ChunkCache()
@@ -48,17 +96,26 @@ ChunkCache::~ChunkCache()
 
 void ChunkCache::join()
 {
+    // Called explicitly to flush before the build is saved, and again by our
+    // destructor.
+    if (m_joined) return;
+    m_joined = true;
+
+    // Insertion is done, so nothing evicted from here on will be reawakened.
+    m_spill.finish();
     maybePurge(0);
     m_pool.join();
 
+    // Everything has now been evicted, so encode it all to the output.
+    m_pool.go();
+    m_spill.flush(m_pool);
+    m_pool.join();
+
     assert(
         std::all_of(
             m_slices.begin(),
             m_slices.end(),
-            [](const std::map<Xyz, ReffedChunk>& slice)
-            {
-                return slice.empty();
-            }));
+            [](const ChunkSlice& slice) { return slice.empty(); }));
 }
 
 void ChunkCache::insert(
@@ -79,20 +136,62 @@ void ChunkCache::insert(
     if (chunk->insert(*this, clipper, voxel, key)) return;
 
     // Failed to insert - need to traverse to the next depth.
-    key.step(voxel.point());
-    const Dir dir(getDirection(ck.bounds().mid(), voxel.point()));
+    key.step();
+    const Dir dir(key.dirAt(ck.depth()));
     insert(voxel, key, chunk->childAt(dir), clipper);
 }
 
+void ChunkCache::insert(
+        Pending* begin,
+        Pending* end,
+        const ChunkKey& ck,
+        Clipper& clipper)
+{
+    if (begin == end) return;
+    assert(ck.depth() < maxDepth);
+
+    // One lookup for the whole group.
+    Chunk* chunk = clipper.get(ck);
+    if (!chunk) chunk = &addRef(ck, clipper);
+
+    Pending* rest(chunk->insert(*this, clipper, begin, end));
+
+    // Group the points which failed to insert here by the child they
+    // continue into, and traverse to the next depth.
+    const auto dir([&ck](const Pending& p)
+    {
+        return toIntegral(p.key.dirAt(ck.depth()));
+    });
+
+    for (Pending* p(rest); p != end; ++p) p->key.step();
+    std::sort(rest, end, [&dir](const Pending& a, const Pending& b)
+    {
+        return dir(a) < dir(b);
+    });
+
+    while (rest != end)
+    {
+        const uint64_t d(dir(*rest));
+        Pending* next(std::find_if(rest, end, [&dir, d](const Pending& p)
+        {
+            return dir(p) != d;
+        }));
+
+        insert(rest, next, chunk->childAt(toDir(d)), clipper);
+        rest = next;
+    }
+}
+
 Chunk& ChunkCache::addRef(const ChunkKey& ck, Clipper& clipper)
 {
     // This is the first access of this chunk for a particular thread.
-    UniqueSpin sliceLock(m_spins[ck.depth()]);
+    ChunkSlice::Shard& shard(m_slices[ck.depth()].shard(ck.position()));
+    UniqueSpin shardLock(shard.spin);
 
-    auto& slice(m_slices[ck.depth()]);
-    auto it(slice.find(ck.position()));
+    auto& chunks(shard.chunks);
+    auto it(chunks.find(ck.position()));
 
-    if (it != slice.end())
+    if (it != chunks.end())
     {
         // We've found a reffed chunk here.  The chunk itself may not exist,
         // since the serialization and deletion steps occur asynchronously.
@@ -100,7 +199,14 @@ Chunk& ChunkCache::addRef(const ChunkKey& ck, Clipper& clipper)
         UniqueSpin chunkLock(ref.spin());
         ref.add();
 
-        sliceLock.unlock();
+        shardLock.unlock();
+
+        // A chunk awaiting serialization is not counted against our budget,
+        // so count it again now that it has been reclaimed.
+        if (ref.count() == 1 && ref.exists())
+        {
+            m_resident += ref.chunk().accountedBytes();
+        }
 
         if (!ref.exists())
         {
@@ -113,6 +219,7 @@ Chunk& ChunkCache::addRef(const ChunkKey& ck, Clipper& clipper)
             // being erased.
             ref.assign(m_metadata, ck, m_hierarchy);
             assert(ref.exists());
+            m_resident += ref.chunk().accountedBytes();
 
             {
                 SpinGuard lock(infoSpin);
@@ -125,9 +232,15 @@ Chunk& ChunkCache::addRef(const ChunkKey& ck, Clipper& clipper)
             // Need to insert this ref prior to loading the chunk or we'll end
             // up deadlocked.
             clipper.set(ck, &ref.chunk());
-            ref.chunk().load(*this, clipper, m_endpoints, np);
+            load(ref.chunk(), ck, clipper, np);
+        }
+        else
+        {
+            clipper.set(ck, &ref.chunk());
+
+            SpinGuard lock(infoSpin);
+            ++info.hits;
         }
-        else clipper.set(ck, &ref.chunk());
 
         chunkLock.unlock();
 
@@ -147,7 +260,7 @@ Chunk& ChunkCache::addRef(const ChunkKey& ck, Clipper& clipper)
     }
 
     // Couldn't find this chunk, create it.
-    auto insertion = slice.emplace(
+    auto insertion = chunks.emplace(
             std::piecewise_construct,
             std::forward_as_tuple(ck.position()),
             std::forward_as_tuple(m_metadata, ck, m_hierarchy));
@@ -166,13 +279,14 @@ Chunk& ChunkCache::addRef(const ChunkKey& ck, Clipper& clipper)
     // We shouldn't have any existing refs yet, but the chunk should exist.
     assert(!ref.count());
     assert(ref.exists());
+    m_resident += ref.chunk().accountedBytes();
 
-    // Since we're still holding the slice lock, no one else can access this
-    // chunk yet.  Add our ref and then we can release the slice lock.
+    // Since we're still holding the shard lock, no one else can access this
+    // chunk yet.  Add our ref and then we can release the shard lock.
     ref.add();
     clipper.set(ck, &ref.chunk());
 
-    sliceLock.unlock();
+    shardLock.unlock();
 
     // Initialize with remote data if we're reawakening this chunk.  It's ok
     // if other threads are inserting here concurrently, and we have already
@@ -188,7 +302,7 @@ Chunk& ChunkCache::addRef(const ChunkKey& ck, Clipper& clipper)
             ++info.read;
         }
 
-        ref.chunk().load(*this, clipper, m_endpoints, np);
+        load(ref.chunk(), ck, clipper, np);
     }
 
     return ref.chunk();
@@ -199,14 +313,15 @@ void ChunkCache::clip(uint64_t depth, const std::map<Xyz, Chunk*>& stale)
     if (stale.empty()) return;
 
     auto& slice(m_slices[depth]);
-    UniqueSpin sliceLock(m_spins[depth]);
 
     for (const auto& p : stale)
     {
         const auto& key(p.first);
-        assert(slice.count(key));
+        ChunkSlice::Shard& shard(slice.shard(key));
+        UniqueSpin shardLock(shard.spin);
+        assert(shard.chunks.count(key));
 
-        ReffedChunk& ref(slice.at(key));
+        ReffedChunk& ref(shard.chunks.at(key));
         UniqueSpin chunkLock(ref.spin());
 
         assert(ref.count());
@@ -214,38 +329,46 @@ void ChunkCache::clip(uint64_t depth, const std::map<Xyz, Chunk*>& stale)
         {
             // Defer erasing here, instead adding taking ownership.
             ref.add();
+            const Owned owned(m_tick, &ref.chunk());
 
             chunkLock.unlock();
-            sliceLock.unlock();
-
-            {
-                SpinGuard ownedLock(m_ownedSpin);
-                const Dxyz dxyz(depth, key);
-                assert(!m_owned.count(dxyz));
-                m_owned.insert(dxyz);
-            }
+            shardLock.unlock();
 
-            sliceLock.lock();
+            SpinGuard ownedLock(m_ownedSpin);
+            const Dxyz dxyz(depth, key);
+            assert(!m_owned.count(dxyz));
+            m_owned.insert(std::make_pair(dxyz, owned));
         }
     }
 }
 
 void ChunkCache::maybePurge(const uint64_t maxCacheSize)
 {
-    uint64_t disowned(0);
+    std::vector<Victim> victims;
     UniqueSpin ownedLock(m_ownedSpin);
-    while (m_owned.size() > maxCacheSize)
+    while (overBudget(maxCacheSize))
     {
-        ++disowned;
+        // Rank our candidates once per batch of evictions, rather than
+        // scanning all of them for each one.
+        if (victims.empty()) victims = selectVictims(maxCacheSize);
 
-        const Dxyz dxyz(*m_owned.rbegin());
-        auto& slice(m_slices[dxyz.depth()]);
-        UniqueSpin sliceLock(m_spins[dxyz.depth()]);
+        const Dxyz dxyz(victims.back().first);
+        const uint64_t tick(victims.back().second);
+        victims.pop_back();
 
-        ReffedChunk& ref(slice.at(dxyz.position()));
+        // We drop our lock while serializing, so an inserting thread may have
+        // reclaimed this one, and perhaps released it again, since it was
+        // ranked.
+        const auto victim(m_owned.find(dxyz));
+        if (victim == m_owned.end() || victim->second.tick != tick) continue;
+
+        auto& shard(m_slices[dxyz.depth()].shard(dxyz.position()));
+        UniqueSpin shardLock(shard.spin);
+
+        ReffedChunk& ref(shard.chunks.at(dxyz.position()));
         UniqueSpin chunkLock(ref.spin());
 
-        m_owned.erase(std::prev(m_owned.end()));
+        m_owned.erase(victim);
 
         // If we're destructing and thus purging everything, we should be the
         // only ref-holder.
@@ -253,11 +376,13 @@ void ChunkCache::maybePurge(const uint64_t maxCacheSize)
 
         if (!ref.del())
         {
+            m_resident -= ref.chunk().accountedBytes();
+
             // Once we've unreffed this chunk, all bets are off as to its
             // validity.  It may be recaptured before deletion by an insertion
             // thread, or may be deleted instantly.
             chunkLock.unlock();
-            sliceLock.unlock();
+            shardLock.unlock();
             ownedLock.unlock();
 
             // Don't hold any locks while we do this, since it may block.  We
@@ -270,12 +395,96 @@ void ChunkCache::maybePurge(const uint64_t maxCacheSize)
     }
 }
 
+void ChunkCache::load(
+    Chunk& chunk,
+    const ChunkKey& ck,
+    Clipper& clipper,
+    const uint64_t np)
+{
+    // Chunks evicted during this build come back from the spill store, while
+    // anything else was written by a previous build.
+    std::vector<char> records;
+    if (m_spill.take(ck.dxyz(), records))
+    {
+        {
+            SpinGuard lock(infoSpin);
+            ++info.reloads;
+        }
+
+        chunk.load(*this, clipper, std::move(records));
+    }
+    else chunk.load(*this, clipper, m_endpoints, np);
+}
+
+bool ChunkCache::overBudget(const uint64_t maxCacheSize) const
+{
+    if (m_owned.size() > maxCacheSize) return true;
+    return overMemory() && !m_owned.empty();
+}
+
+std::vector<ChunkCache::Victim> ChunkCache::selectVictims(
+    const uint64_t maxCacheSize) const
+{
+    // Prefer the chunks that have gone unused the longest, weighted by the
+    // memory that serializing them would free.
+    struct Candidate
+    {
+        uint64_t score;
+        uint64_t bytes;
+        Victim victim;
+    };
+
+    const uint64_t now(m_tick);
+    std::vector<Candidate> candidates;
+    candidates.reserve(m_owned.size());
+    for (const auto& p : m_owned)
+    {
+        const Owned& owned(p.second);
+        const uint64_t age(now - std::min(now, owned.tick) + 1);
+        const uint64_t bytes(owned.chunk->accountedBytes());
+        candidates.push_back(
+            Candidate { age * bytes, bytes, Victim(p.first, owned.tick) });
+    }
+
+    std::stable_sort(
+        candidates.begin(),
+        candidates.end(),
+        [](const Candidate& a, const Candidate& b)
+        {
+            return a.score > b.score;
+        });
+
+    // Enough victims to bring both our count and our memory within budget,
+    // as far as we can tell from here.
+    const uint64_t count(
+        m_owned.size() > maxCacheSize ? m_owned.size() - maxCacheSize : 0);
+    const uint64_t resident(m_resident);
+    const uint64_t excess(
+        m_maxMemory && resident > m_maxMemory ? resident - m_maxMemory : 0);
+
+    std::vector<Victim> victims;
+    uint64_t freed(0);
+    for (const Candidate& c : candidates)
+    {
+        if (victims.size() >= count && freed >= excess && !victims.empty())
+        {
+            break;
+        }
+        victims.push_back(c.victim);
+        freed += c.bytes;
+    }
+
+    std::reverse(victims.begin(), victims.end());
+    return victims;
+}
+
 void ChunkCache::maybeSerialize(const Dxyz& dxyz)
 {
     // Acquire both locks in order and see what we need to do.
-    UniqueSpin sliceLock(m_spins[dxyz.depth()]);
-    auto& slice(m_slices[dxyz.depth()]);
-    auto it(slice.find(dxyz.position()));
+    auto& shard(m_slices[dxyz.depth()].shard(dxyz.position()));
+    UniqueSpin shardLock(shard.spin);
+    auto& chunks(shard.chunks);
+    auto it(chunks.find(dxyz.position()));
 
     // This case represents a chunk that has been queued for serialization,
     // then reclaimed, and then queued for serialization again.  If the first
@@ -285,7 +494,7 @@ void ChunkCache::maybeSerialize(const Dxyz& dxyz)
     //
     // This check keeps us from having to search our serialization queue for
     // cleanup every time a chunk is reclaimed prior to its async serialization.
-    if (it == slice.end()) return;
+    if (it == chunks.end()) return;
 
     ReffedChunk& ref = it->second;
     UniqueSpin chunkLock(ref.spin());
@@ -306,41 +515,52 @@ void ChunkCache::maybeSerialize(const Dxyz& dxyz)
     // At this point, we have both locks, and we know our chunk exists but has
     // no refs, so serialize it.
     //
-    // The actual IO is expensive, so retain only the chunk lock.  Note: As
-    // soon as we let go of the slice lock, another thread could arrive and be
-    // waiting for this chunk lock, so we can't delete the ref from our map
-    // outright after this point without reclaiming the locks.
-    sliceLock.unlock();
+    // Retain only the chunk lock.  As soon as we let go of the shard lock,
+    // another thread could arrive and be waiting for this chunk lock, so we
+    // can't delete the ref from our map outright after this point without
+    // reclaiming the locks.
+    shardLock.unlock();
 
     assert(ref.exists());
 
+    const uint64_t bytes = ref.chunk().bytes();
+    const uint64_t np = ref.chunk().points();
+    hierarchy::set(m_hierarchy, ref.chunk().chunkKey().get(), np);
+    assert(np);
+
     {
         SpinGuard lock(infoSpin);
         ++info.written;
+        info.bytes += bytes;
+        info.points += np;
     }
 
-    const uint64_t np = ref.chunk().save(m_endpoints);
-    hierarchy::set(m_hierarchy, ref.chunk().chunkKey().get(), np);
-    assert(np);
-
     // Cannot erase this chunk here, since we haven't been holding the
-    // sliceLock, someone may be waiting for this chunkLock.  Instead we'll
-    // just reset the pointer.  We'll have to reacquire both locks to attempt
-    // to erase it.
-    ref.reset();
+    // shardLock, someone may be waiting for this chunkLock.  Instead we'll
+    // hand the chunk itself to the spill store, leaving the pointer empty.
+    // We'll have to reacquire both locks to attempt to erase it.
+    //
+    // This only moves the pointer, so the points are never copied while we
+    // hold the lock.
+    m_spill.put(dxyz, ref.release());
     chunkLock.unlock();
 
+    // Now that other threads may reclaim this chunk, gather and compress its
+    // records - or find that they have already been taken back.
+    m_spill.settle(dxyz);
+
     maybeErase(dxyz);
 }
 
 void ChunkCache::maybeErase(const Dxyz& dxyz)
 {
-    UniqueSpin sliceLock(m_spins[dxyz.depth()]);
-    auto& slice(m_slices[dxyz.depth()]);
-    auto it(slice.find(dxyz.position()));
+    auto& shard(m_slices[dxyz.depth()].shard(dxyz.position()));
+    UniqueSpin shardLock(shard.spin);
+    auto& chunks(shard.chunks);
+    auto it(chunks.find(dxyz.position()));
 
     // If the chunk has already been erased, no-op.
-    if (it == slice.end()) return;
+    if (it == chunks.end()) return;
 
     ReffedChunk& ref = it->second;
     UniqueSpin chunkLock(ref.spin());
@@ -353,7 +573,7 @@ void ChunkCache::maybeErase(const Dxyz& dxyz)
     // Release the chunkLock so the unique_lock doesn't try to unlock a deleted
     // SpinLock when it destructs.
     chunkLock.release();
-    slice.erase(it);
+    chunks.erase(it);
 
     {
         SpinGuard lock(infoSpin);
@@ -11,12 +11,20 @@
 #pragma once
 
 #include <array>
+#include <atomic>
+#include <cstddef>
+#include <map>
+#include <unordered_map>
+#include <utility>
+#include <vector>
 
 #include <entwine/builder/chunk.hpp>
 #include <entwine/builder/hierarchy.hpp>
+#include <entwine/builder/spill-store.hpp>
 #include <entwine/types/defs.hpp>
 #include <entwine/util/pool.hpp>
 #include <entwine/util/spin-lock.hpp>
+#include <entwine/util/unique.hpp>
 
 namespace entwine
 {
@@ -47,6 +55,7 @@ public:
     }
 
     void reset() { m_chunk.reset(); }
+    std::unique_ptr<Chunk> release() { return std::move(m_chunk); }
     bool exists() { return !!m_chunk; }
     void assign(const Metadata& m, const ChunkKey& ck, const Hierarchy& h)
     {
@@ -55,11 +64,55 @@ public:
     }
 
 private:
-    SpinLock m_spin;
+    SpinLock m_spin{ locks::chunk };
     uint64_t m_refs = 0;
     std::unique_ptr<Chunk> m_chunk;
 };
 
+struct XyzHash
+{
+    std::size_t operator()(const Xyz& p) const
+    {
+        uint64_t h(
+            (p.x * 0x9e3779b97f4a7c15ull) ^
+            (p.y * 0xc2b2ae3d27d4eb4full) ^
+            (p.z * 0x165667b19e3779f9ull));
+
+        // Finalize so that the low bits, used for shards and buckets, depend
+        // on every input bit.
+        h ^= h >> 33;
+        h *= 0xff51afd7ed558ccdull;
+        h ^= h >> 33;
+        return h;
+    }
+};
+
+// The chunks at a single depth.  These are split into shards by position, each
+// with its own lock, so that threads accessing different chunks rarely contend
+// even at the shallow depths which every insertion passes through.
+class ChunkSlice
+{
+public:
+    struct alignas(cacheLineSize) Shard
+    {
+        SpinLock spin{ locks::shard };
+        std::unordered_map<Xyz, ReffedChunk, XyzHash> chunks;
+    };
+
+    Shard& shard(const Xyz& p) { return m_shards[XyzHash()(p) % shards]; }
+
+    // Not thread-safe.
+    bool empty() const
+    {
+        for (const Shard& s : m_shards) if (!s.chunks.empty()) return false;
+        return true;
+    }
+
+private:
+    static constexpr std::size_t shards = 64;
+    std::array<Shard, shards> m_shards;
+};
+
 class ChunkCache
 {
 public:
@@ -72,36 +125,97 @@ public:
     ~ChunkCache();
 
     void insert(Voxel& voxel, Key& key, const ChunkKey& ck, Clipper& clipper);
+
+    // Insert a batch of points, starting at the chunk ck.  The batch is
+    // reordered as its points are grouped by the chunks they reach.
+    void insert(
+        Pending* begin,
+        Pending* end,
+        const ChunkKey& ck,
+        Clipper& clipper);
     void clip(uint64_t depth, const std::map<Xyz, Chunk*>& stale);
-    void clipped() { maybePurge(m_cacheSize); }
+    void clipped()
+    {
+        ++m_tick;
+        maybePurge(m_cacheSize);
+    }
     void join();
 
+    // Resident byte accounting, reported by chunks as their storage changes.
+    void grew(uint64_t bytes) { m_resident += bytes; }
+    void shrank(uint64_t bytes) { m_resident -= bytes; }
+
+    // Whether resident chunks exceed the memory budget, if there is one.
+    bool overMemory() const
+    {
+        return m_maxMemory && m_resident > m_maxMemory;
+    }
+
     struct Info
     {
         uint64_t written = 0;
         uint64_t read = 0;
         uint64_t alive = 0;
+
+        // Shared chunks found resident by a thread's first access, and chunks
+        // which had to be brought back after being evicted during this build.
+        uint64_t hits = 0;
+        uint64_t reloads = 0;
+
+        // Resident footprint of the chunks written, measured as they are
+        // serialized.
+        uint64_t bytes = 0;
+        uint64_t points = 0;
     };
 
+    // Counts since the previous latch, and since the start of the process.
     static Info latchInfo();
+    static Info totalInfo();
 
 private:
     Chunk& addRef(const ChunkKey& ck, Clipper& clipper);
+    void load(Chunk& chunk, const ChunkKey& ck, Clipper& clipper, uint64_t np);
     void maybeSerialize(const Dxyz& dxyz);
     void maybeErase(const Dxyz& dxyz);
     void maybePurge(uint64_t maxCacheSize);
 
+    // An unreferenced chunk held by the cache, and the clip tick at which it
+    // was last released by an inserting thread.
+    struct Owned
+    {
+        Owned(uint64_t tick, const Chunk* chunk) : tick(tick), chunk(chunk) { }
+
+        uint64_t tick = 0;
+        const Chunk* chunk = nullptr;
+    };
+    using OwnedMap = std::map<Dxyz, Owned>;
+
+    bool overBudget(uint64_t maxCacheSize) const;
+
+    // The owned chunks to evict to bring us within budget, ranked in a single
+    // pass, with the ticks at which they were ranked.  The first victim to
+    // evict is last.
+    using Victim = std::pair<Dxyz, uint64_t>;
+    std::vector<Victim> selectVictims(uint64_t maxCacheSize) const;
+
     const Endpoints& m_endpoints;
     const Metadata& m_metadata;
     Hierarchy& m_hierarchy;
     Pool m_pool;
-    const uint64_t m_cacheSize = 64;
+    const uint64_t m_cacheSize;
+    const uint64_t m_maxMemory;
+    SpillStore m_spill;
+
+    std::array<ChunkSlice, maxDepth> m_slices;
+
+    // Bytes held by chunks with at least one reference.
+    std::atomic<uint64_t> m_resident;
+    std::atomic<uint64_t> m_tick;
 
-    std::array<SpinLock, maxDepth> m_spins;
-    std::array<std::map<Xyz, ReffedChunk>, maxDepth> m_slices;
+    SpinLock m_ownedSpin{ locks::owned };
+    OwnedMap m_owned;
 
-    SpinLock m_ownedSpin;
-    std::set<Dxyz> m_owned;
+    bool m_joined = false;
 };
 
 } // namespace entwine
@@ -10,7 +10,10 @@
 
 #include <entwine/builder/chunk.hpp>
 
+#include <algorithm>
+
 #include <entwine/builder/chunk-cache.hpp>
+#include <entwine/builder/heuristics.hpp>
 #include <entwine/io/io.hpp>
 #include <entwine/types/metadata.hpp>
 #include <entwine/types/voxel.hpp>
@@ -22,7 +25,7 @@ namespace entwine
 Chunk::Chunk(const Metadata& m, const ChunkKey& ck, const Hierarchy& hierarchy)
     : m_metadata(m)
     , m_span(m_metadata.span)
-    , m_pointSize(getPointSize(m_metadata.absoluteSchema))
+    , m_pointSize(getPointSize(m_metadata.memorySchema))
     , m_chunkKey(ck)
     , m_childKeys { {
         ck.getStep(toDir(0)),
@@ -34,8 +37,11 @@ Chunk::Chunk(const Metadata& m, const ChunkKey& ck, const Hierarchy& hierarchy)
         ck.getStep(toDir(6)),
         ck.getStep(toDir(7))
     } }
-    , m_grid(m_span * m_span)
-    , m_gridBlock(m_pointSize, 4096)
+    , m_xyz(m_metadata.memorySchema)
+    , m_grid(m_span)
+    , m_records(m_pointSize, 4096)
+    , m_gridBytes(sizeof(Chunk) + m_grid.bytes() + m_records.bytes())
+    , m_overflowBytes(0)
 {
     for (uint64_t i(0); i < dirEnd(); ++i)
     {
@@ -44,62 +50,320 @@ Chunk::Chunk(const Metadata& m, const ChunkKey& ck, const Hierarchy& hierarchy)
         // If there are already points here, it gets no overflow.
         if (!hierarchy::get(hierarchy, childAt(dir).dxyz()))
         {
-            m_overflows[i] = makeUnique<Overflow>(ck.getStep(dir), m_pointSize);
+            auto& overflow(m_overflows[i].overflow);
+            overflow = makeUnique<Overflow>(ck.getStep(dir));
+            m_overflows[i].active = true;
+            m_overflowBytes += overflow->bytes();
         }
     }
 }
 
 bool Chunk::insert(ChunkCache& cache, Clipper& clipper, Voxel& voxel, Key& key)
 {
-    const Xyz& pos(key.position());
-    const uint64_t i((pos.y % m_span) * m_span + (pos.x % m_span));
-    auto& tube(m_grid[i]);
+    const uint64_t i(tubeIndex(key));
+
+    const Saturation saturation(m_saturation);
+    if (saturation == Saturation::Saturated && rejects(voxel, key, i))
+    {
+        return false;
+    }
+
+    char* incoming(nullptr);
+    bool kept(false);
+    {
+        VoxelGrid::Block& block(m_grid.block(i));
+        SpinGuard lock(block.spin);
+        kept = place(cache, VoxelGrid::tube(block, i), i, voxel, key, incoming);
+    }
+
+    if (!kept) kept = settle(cache, clipper, voxel, key, incoming);
+    if (saturation == Saturation::Tracking)
+    {
+        track(cache, 1, (kept || incoming) ? 1 : 0);
+    }
+    return kept;
+}
+
+Pending* Chunk::insert(
+        ChunkCache& cache,
+        Clipper& clipper,
+        Pending* begin,
+        Pending* end)
+{
+    const Saturation saturation(m_saturation);
+    const uint64_t attempts(end - begin);
+
+    for (Pending* p(begin); p != end; ++p)
+    {
+        p->tube = tubeIndex(p->key);
+        p->kept = false;
+    }
 
-    UniqueSpin tubeLock(tube.spin);
-    Voxel& dst(tube.map[pos.z]);
+    // Points which our summary rejects go straight to the back.
+    if (saturation == Saturation::Saturated)
+    {
+        end = std::partition(begin, end, [this](const Pending& p)
+        {
+            return !rejects(p.voxel, p.key, p.tube);
+        });
+    }
 
-    if (dst.data())
+    // Group the rest by tube, so each block is locked once per run.
+    std::sort(begin, end, [](const Pending& a, const Pending& b)
     {
-        const Point& mid(key.bounds().mid());
-        if (voxel.point().sqDist3d(mid) < dst.point().sqDist3d(mid))
+        return a.tube < b.tube;
+    });
+
+    uint64_t placed(0);
+    Pending* run(begin);
+    while (run != end)
+    {
+        const uint64_t b(run->tube / 64);
+        Pending* next(std::find_if(run, end, [b](const Pending& p)
+        {
+            return p.tube / 64 != b;
+        }));
+
+        {
+            VoxelGrid::Block& block(m_grid.block(run->tube));
+            SpinGuard lock(block.spin);
+
+            for (Pending* p(run); p != next; ++p)
+            {
+                VoxelTube& tube(VoxelGrid::tube(block, p->tube));
+                p->incoming = nullptr;
+                p->kept = place(
+                        cache,
+                        tube,
+                        p->tube,
+                        p->voxel,
+                        p->key,
+                        p->incoming);
+            }
+        }
+
+        for (Pending* p(run); p != next; ++p)
         {
-            voxel.swapDeep(dst, m_pointSize);
+            if (!p->kept)
+            {
+                p->kept = settle(cache, clipper, p->voxel, p->key, p->incoming);
+            }
+            if (p->kept || p->incoming) ++placed;
         }
+
+        run = next;
+    }
+
+    if (saturation == Saturation::Tracking) track(cache, attempts, placed);
+
+    return std::partition(begin, end, [](const Pending& p) { return p.kept; });
+}
+
+bool Chunk::place(
+        ChunkCache& cache,
+        VoxelTube& tube,
+        const uint64_t i,
+        Voxel& voxel,
+        Key& key,
+        char*& incoming)
+{
+    char*& dst(tube.at(key.position().z));
+
+    if (dst)
+    {
+        const Point mid(key.mid());
+        const Point current(getPoint(dst));
+        if (voxel.point().sqDist3d(mid) < current.sqDist3d(mid))
+        {
+            char* record(acquire(cache));
+            std::copy(voxel.data(), voxel.data() + m_pointSize, record);
+
+            incoming = voxel.data();
+            voxel.initShallow(current, dst);
+            key.init(current, m_chunkKey.depth());
+            dst = record;
+
+            // Read under the block lock, so a summary being built can't miss
+            // this change.
+            if (m_saturation >= Saturation::Summarizing) summarize(i, tube);
+        }
+        return false;
+    }
+
+    dst = acquire(cache);
+    std::copy(voxel.data(), voxel.data() + m_pointSize, dst);
+    if (m_saturation >= Saturation::Summarizing) summarize(i, tube);
+    return true;
+}
+
+bool Chunk::settle(
+        ChunkCache& cache,
+        Clipper& clipper,
+        Voxel& voxel,
+        Key& key,
+        char* incoming)
+{
+    const bool swapped(incoming);
+    const bool overflowed(insertOverflow(cache, clipper, voxel, key, swapped));
+    if (swapped && !overflowed)
+    {
+        // The displaced point continues to our child, which will copy it, so
+        // move it into the record left behind by the incoming point.
+        std::copy(voxel.data(), voxel.data() + m_pointSize, incoming);
+        release(voxel.data());
+        voxel.setData(incoming);
+    }
+    return overflowed;
+}
+
+char* Chunk::acquire(ChunkCache& cache)
+{
+    SpinGuard lock(m_spin);
+    if (!m_free.empty())
+    {
+        char* record(m_free.back());
+        m_free.pop_back();
+        return record;
+    }
+
+    const uint64_t before(m_records.bytes());
+    char* record(m_records.next());
+    const uint64_t after(m_records.bytes());
+    if (after != before)
+    {
+        m_gridBytes += after - before;
+        cache.grew(after - before);
+    }
+    return record;
+}
+
+void Chunk::release(char* record)
+{
+    SpinGuard lock(m_spin);
+    m_free.push_back(record);
+}
+
+bool Chunk::rejects(const Voxel& voxel, const Key& key, const uint64_t i) const
+{
+    if (m_chunkKey.depth() >= getSharedDepth(m_metadata))
+    {
+        const Dir dir(key.dirAt(m_chunkKey.depth()));
+        if (m_overflows[toIntegral(dir)].active) return false;
+    }
+
+    const uint32_t z(key.position().z);
+    return m_summary->rejects(i, z, voxel.point().sqDist3d(key.mid()));
+}
+
+void Chunk::track(
+        ChunkCache& cache,
+        const uint64_t attempts,
+        const uint64_t placed)
+{
+    if (placed) m_placed += placed;
+
+    const uint64_t before(m_attempts.fetch_add(attempts));
+    const uint64_t window(heuristics::saturationWindow);
+    if (before / window == (before + attempts) / window) return;
+
+    const uint64_t np(m_placed.exchange(0));
+    if (np * heuristics::saturationRatio < window) saturate(cache);
+}
+
+void Chunk::saturate(ChunkCache& cache)
+{
+    Saturation expected(Saturation::Tracking);
+    if (!m_saturation.compare_exchange_strong(expected, Saturation::Claimed))
+    {
+        return;
     }
-    else
+
+    m_summary = makeUnique<RejectionSummary>(m_span);
+    m_gridBytes += m_summary->bytes();
+    cache.grew(m_summary->bytes());
+
+    // From here, inserters keep the tubes they modify up to date, so once
+    // we've visited every block, the summary is complete.
+    m_saturation = Saturation::Summarizing;
+
+    const uint64_t tubes(m_span * m_span);
+    for (uint64_t b(0); b < tubes; b += 64)
     {
+        VoxelGrid::Block& block(m_grid.block(b));
+        SpinGuard lock(block.spin);
+
+        for (uint64_t i(b); i < std::min(b + 64, tubes); ++i)
         {
-            SpinGuard lock(m_spin);
-            dst.setData(m_gridBlock.next());
+            if (const VoxelTube* tube = VoxelGrid::find(block, i))
+            {
+                summarize(i, *tube);
+            }
         }
-        dst.initDeep(voxel.point(), voxel.data(), m_pointSize);
-        return true;
     }
 
-    tubeLock.unlock();
+    m_saturation = Saturation::Saturated;
+}
+
+void Chunk::summarize(const uint64_t i, const VoxelTube& tube)
+{
+    const uint64_t depth(getStartDepth(m_metadata) + m_chunkKey.depth());
+    const Xyz& cp(m_chunkKey.position());
+    const uint64_t x(cp.x * m_span + i % m_span);
+    const uint64_t y(cp.y * m_span + i / m_span);
 
-    return insertOverflow(cache, clipper, voxel, key);
+    m_summary->update(i, tube, [&](uint32_t z, const char* data)
+    {
+        const Point mid(m_metadata.quantizer.mid(Xyz(x, y, z), depth));
+        return getPoint(data).sqDist3d(mid);
+    });
 }
 
 bool Chunk::insertOverflow(
         ChunkCache& cache,
         Clipper& clipper,
         Voxel& voxel,
-        Key& key)
+        Key& key,
+        const bool owned)
 {
     if (m_chunkKey.depth() < getSharedDepth(m_metadata)) return false;
 
-    const Dir dir(getDirection(m_chunkKey.bounds().mid(), voxel.point()));
+    // Overflow entries rebuild their keys from this relationship.
+    assert(key.depth() == getStartDepth(m_metadata) + m_chunkKey.depth());
+
+    const Dir dir(key.dirAt(m_chunkKey.depth()));
     const uint64_t i(toIntegral(dir));
 
-    SpinGuard lock(m_overflowSpin);
+    OverflowSlot& slot(m_overflows[i]);
+    uint64_t count(0);
+
+    {
+        SpinGuard lock(slot.spin);
+        if (!slot.overflow) return false;
 
-    if (!m_overflows[i]) return false;
+        Overflow& overflow(*slot.overflow);
+        char* record(owned ? voxel.data() : acquire(cache));
+        if (!owned)
+        {
+            std::copy(voxel.data(), voxel.data() + m_pointSize, record);
+        }
+
+        const uint64_t before(overflow.bytes());
+        overflow.insert(voxel.point(), record);
+        const uint64_t after(overflow.bytes());
+        if (after != before)
+        {
+            m_overflowBytes += after - before;
+            cache.grew(after - before);
+        }
 
-    m_overflows[i]->insert(voxel, key);
+        // Counted under the slot lock, so that swapping out this overflow
+        // can subtract exactly what was added.
+        ++slot.size;
+        count = ++m_overflowCount;
+    }
 
-    // Overflow inserted, update metric and perform overflow if needed.
-    if (++m_overflowCount >= m_metadata.internal.minNodeSize)
+    // Overflow inserted, perform overflow if needed.
+    if (count >= m_metadata.internal.minNodeSize)
     {
         maybeOverflow(cache, clipper);
     }
@@ -109,14 +373,14 @@ bool Chunk::insertOverflow(
 
 void Chunk::maybeOverflow(ChunkCache& cache, Clipper& clipper)
 {
-    // See if our resident size is big enough to overflow.
-    uint64_t gridSize(0);
+    // See if our resident size, including overflowed points, is big enough
+    // to overflow.
+    uint64_t ourSize(0);
     {
         SpinGuard lock(m_spin);
-        gridSize = m_gridBlock.size();
+        ourSize = points();
     }
 
-    const uint64_t ourSize(gridSize + m_overflowCount);
     if (ourSize < m_metadata.internal.maxNodeSize) return;
 
     // Find the overflow with the largest point count.
@@ -124,11 +388,11 @@ void Chunk::maybeOverflow(ChunkCache& cache, Clipper& clipper)
     uint64_t selectedIndex = 0;
     for (uint64_t d(0); d < m_overflows.size(); ++d)
     {
-        auto& current(m_overflows[d]);
-        if (current && current->block.size() > selectedSize)
+        const uint64_t size(m_overflows[d].size);
+        if (size > selectedSize)
         {
             selectedIndex = d;
-            selectedSize = current->block.size();
+            selectedSize = size;
         }
     }
 
@@ -141,47 +405,83 @@ void Chunk::maybeOverflow(ChunkCache& cache, Clipper& clipper)
 
 void Chunk::doOverflow(ChunkCache& cache, Clipper& clipper, uint64_t dir)
 {
-    assert(m_overflows[dir]);
-
+    OverflowSlot& slot(m_overflows[dir]);
     std::unique_ptr<Overflow> active;
-    std::swap(m_overflows[dir], active);
-    m_overflowCount -= active->block.size();
 
-    // TODO We could unlock our overflowSpin here - bookkeeping has been
-    // fully updated for the removal of this Overflow.
+    {
+        SpinGuard lock(slot.spin);
+
+        // Another thread may have selected this overflow before us.
+        if (!slot.overflow) return;
 
+        std::swap(slot.overflow, active);
+        slot.active = false;
+        m_overflowCount -= active->list.size();
+        slot.size = 0;
+    }
+
+    const uint64_t bytes(active->bytes());
+    m_overflowBytes -= bytes;
+    cache.shrank(bytes);
+
+    // This overflow is now ours alone, and new points in its direction will
+    // go straight to the child, so reinsert without holding any lock.
     const ChunkKey ck(m_childKeys[dir]);
 
-    for (auto& entry : active->list)
+    Voxel voxel;
+    Key key(m_metadata.quantizer, getStartDepth(m_metadata));
+
+    std::vector<Pending> pending;
+    pending.reserve(active->list.size());
+    for (const Overflow::Entry& entry : active->list)
     {
-        entry.key.step(entry.voxel.point());
-        cache.insert(entry.voxel, entry.key, ck, clipper);
+        voxel.initShallow(entry.point, entry.data);
+        key.init(entry.point, m_chunkKey.depth());
+        key.step();
+        pending.emplace_back(voxel, key);
+    }
+    cache.insert(pending.data(), pending.data() + pending.size(), ck, clipper);
+
+    // Our child has copied all of these points.
+    SpinGuard lock(m_spin);
+    for (const Overflow::Entry& entry : active->list)
+    {
+        m_free.push_back(entry.data);
     }
 }
 
-uint64_t Chunk::save(const Endpoints& endpoints) const
+std::vector<char> Chunk::gather() const
 {
-    uint64_t np(m_gridBlock.size());
-    for (const auto& o : m_overflows) if (o) np += o->block.size();
-
-    auto layout = toLayout(m_metadata.absoluteSchema);
-    BlockPointTable table(layout);
-    table.reserve(np);
-    table.insert(m_gridBlock);
-    for (auto& o : m_overflows) if (o) table.insert(o->block);
+    // Released records are still in our storage, so gather only those which
+    // are referenced.
+    std::vector<char> records(points() * m_pointSize);
+    char* pos(records.data());
+    const auto append([&pos, this](const char* p)
+    {
+        pos = std::copy(p, p + m_pointSize, pos);
+    });
 
-    const auto filename =
-        m_chunkKey.toString() + getPostfix(m_metadata, m_chunkKey.depth());
+    m_grid.each(append);
+    for (const auto& s : m_overflows)
+    {
+        if (!s.overflow) continue;
+        for (const Overflow::Entry& e : s.overflow->list) append(e.data);
+    }
 
-    io::write(
-        m_metadata.dataType,
-        m_metadata,
-        endpoints,
-        filename,
-        table,
-        m_chunkKey.bounds());
+    assert(pos == records.data() + records.size());
+    return records;
+}
 
-    return np;
+uint64_t Chunk::bytes() const
+{
+    uint64_t total(sizeof(Chunk) + m_grid.bytes() + m_records.bytes());
+    total += m_free.capacity() * sizeof(char*);
+    if (m_summary) total += m_summary->bytes();
+    for (const auto& s : m_overflows)
+    {
+        if (s.overflow) total += s.overflow->bytes();
+    }
+    return total;
 }
 
 void Chunk::load(
@@ -190,20 +490,9 @@ void Chunk::load(
         const Endpoints& endpoints,
         const uint64_t np)
 {
-    auto layout = toLayout(m_metadata.absoluteSchema);
+    auto layout = toLayout(m_metadata.memorySchema);
     VectorPointTable table(layout, np);
-    table.setProcess([&]()
-    {
-        Voxel voxel;
-        Key key(m_metadata.bounds, getStartDepth(m_metadata));
-
-        for (auto it = table.begin(); it != table.end(); ++it)
-        {
-            voxel.initShallow(it.pointRef(), it.data());
-            key.init(voxel.point(), m_chunkKey.depth());
-            cache.insert(voxel, key, m_chunkKey, clipper);
-        }
-    });
+    table.setProcess([&]() { reinsert(cache, clipper, table); });
 
     const auto filename =
         m_chunkKey.toString() + getPostfix(m_metadata, m_chunkKey.depth());
@@ -211,4 +500,38 @@ void Chunk::load(
     io::read(m_metadata.dataType, m_metadata, endpoints, filename, table);
 }
 
+void Chunk::load(
+        ChunkCache& cache,
+        Clipper& clipper,
+        std::vector<char>&& records)
+{
+    const uint64_t np(records.size() / m_pointSize);
+
+    auto layout = toLayout(m_metadata.memorySchema);
+    VectorPointTable table(layout, std::move(records));
+    table.setProcess([&]() { reinsert(cache, clipper, table); });
+    table.clear(np);
+}
+
+void Chunk::reinsert(
+        ChunkCache& cache,
+        Clipper& clipper,
+        VectorPointTable& table)
+{
+    Voxel voxel;
+    Key key(m_metadata.quantizer, getStartDepth(m_metadata));
+
+    std::vector<Pending> pending;
+    pending.reserve(table.numPoints());
+    for (auto it = table.begin(); it != table.end(); ++it)
+    {
+        voxel.initShallow(m_xyz.get(it.data()), it.data());
+        key.init(voxel.point(), m_chunkKey.depth());
+        pending.emplace_back(voxel, key);
+    }
+
+    Pending* begin(pending.data());
+    cache.insert(begin, begin + pending.size(), m_chunkKey, clipper);
+}
+
 } // namespace entwine
@@ -10,15 +10,23 @@
 
 #pragma once
 
+#include <atomic>
 #include <cassert>
 #include <cstddef>
+#include <cstring>
 #include <utility>
+#include <vector>
 
 #include <entwine/builder/hierarchy.hpp>
 #include <entwine/builder/overflow.hpp>
+#include <entwine/builder/voxel-grid.hpp>
 #include <entwine/third/arbiter/arbiter.hpp>
 #include <entwine/types/endpoints.hpp>
+#include <entwine/types/key.hpp>
+#include <entwine/types/metadata.hpp>
+#include <entwine/types/record.hpp>
 #include <entwine/types/vector-point-table.hpp>
+#include <entwine/types/voxel.hpp>
 #include <entwine/util/spin-lock.hpp>
 
 namespace entwine
@@ -27,10 +35,18 @@ namespace entwine
 class ChunkCache;
 class Clipper;
 
-struct VoxelTube
+// A point on its way down the tree, for batched insertion.
+struct Pending
 {
-    SpinLock spin;
-    std::map<uint32_t, Voxel> map;
+    Pending(const Voxel& voxel, const Key& key) : voxel(voxel), key(key) { }
+
+    Voxel voxel;
+    Key key;
+
+    // Scratch space for the chunk currently inserting this point.
+    uint64_t tube = 0;
+    char* incoming = nullptr;
+    bool kept = false;
 };
 
 class Chunk
@@ -39,12 +55,36 @@ public:
     Chunk(const Metadata& m, const ChunkKey& ck, const Hierarchy& hierarchy);
 
     bool insert(ChunkCache& cache, Clipper& clipper, Voxel& voxel, Key& key);
-    uint64_t save(const Endpoints& endpoints) const;
+
+    // Insert a batch of points belonging to this chunk, with each block locked
+    // once per run of points landing in it.  Points which remain here are
+    // moved to the front, and the first point which must continue to a child
+    // is returned.
+    Pending* insert(
+        ChunkCache& cache,
+        Clipper& clipper,
+        Pending* begin,
+        Pending* end);
+    // The number of points held, and a contiguous copy of their records.  For
+    // a chunk with no inserters.
+    uint64_t points() const { return m_records.size() - m_free.size(); }
+    std::vector<char> gather() const;
+
+    // Resident bytes, including point data, for a chunk with no inserters.
+    uint64_t bytes() const;
+
+    // A running estimate of resident bytes from the sizes of our point blocks,
+    // which is also reported to the cache as it changes.
+    uint64_t accountedBytes() const { return m_gridBytes + m_overflowBytes; }
     void load(
         ChunkCache& cache,
         Clipper& clipper,
         const Endpoints& endpoints,
         uint64_t np);
+    void load(
+        ChunkCache& cache,
+        Clipper& clipper,
+        std::vector<char>&& records);
 
     const ChunkKey& chunkKey() const { return m_chunkKey; }
     const ChunkKey& childAt(Dir dir) const
@@ -55,28 +95,105 @@ public:
     SpinLock& spin() { return m_spin; }
 
 private:
+    uint64_t tubeIndex(const Key& key) const
+    {
+        const Xyz pos(key.position());
+        return (pos.y % m_span) * m_span + (pos.x % m_span);
+    }
+
+    // Try to place a point in the grid, with the block of its tube locked.
+    // Returns true if it filled an empty voxel.  If instead it displaced the
+    // resident, the voxel and key now refer to the displaced point and
+    // incoming is set to the record in which the point arrived.
+    bool place(
+        ChunkCache& cache,
+        VoxelTube& tube,
+        uint64_t i,
+        Voxel& voxel,
+        Key& key,
+        char*& incoming);
+
+    // For a point which was not placed, with no locks held.  Returns true if
+    // it was overflowed, otherwise it must continue to a child.
+    bool settle(
+        ChunkCache& cache,
+        Clipper& clipper,
+        Voxel& voxel,
+        Key& key,
+        char* incoming);
+
+    // If owned, the voxel's record is already one of ours and is handed to
+    // the overflow as is.
     bool insertOverflow(
         ChunkCache& cache,
         Clipper& clipper,
         Voxel& voxel,
-        Key& key);
+        Key& key,
+        bool owned);
+
+    // Storage for a record, and its return once nothing refers to it.
+    char* acquire(ChunkCache& cache);
+    void release(char* record);
+
+    // Whether this point would certainly be rejected, both by the voxel at
+    // position i and by our overflow, once we are saturated.
+    bool rejects(const Voxel& voxel, const Key& key, uint64_t i) const;
+    void track(ChunkCache& cache, uint64_t attempts, uint64_t placed);
+    void saturate(ChunkCache& cache);
+    void summarize(uint64_t i, const VoxelTube& tube);
 
     void maybeOverflow(ChunkCache& cache, Clipper& clipper);
     void doOverflow(ChunkCache& cache, Clipper& clipper, uint64_t dir);
+    void reinsert(
+        ChunkCache& cache,
+        Clipper& clipper,
+        VectorPointTable& table);
+
+    Point getPoint(const char* data) const { return m_xyz.get(data); }
 
     const Metadata& m_metadata;
     const uint64_t m_span;
     const uint64_t m_pointSize;
     const ChunkKey m_chunkKey;
     const std::array<ChunkKey, 8> m_childKeys;
+    const RecordXyz m_xyz;
+
+    SpinLock m_spin{ locks::chunk };
+    VoxelGrid m_grid;
+
+    // Records are copied in here once, after which the grid and overflows hand
+    // them between each other by pointer.  Released records are reused.
+    MemBlock m_records;
+    std::vector<char*> m_free;
+
+    // Once nearly every point passing through is rejected, we keep a summary
+    // of our tubes, which is maintained under their block locks.  After it
+    // has been fully built, points it rejects are turned away before taking
+    // any lock.  They still visit us on their way to our children.
+    enum class Saturation { Tracking, Claimed, Summarizing, Saturated };
+    std::atomic<Saturation> m_saturation{ Saturation::Tracking };
+    std::atomic<uint64_t> m_attempts{ 0 };
+    std::atomic<uint64_t> m_placed{ 0 };
+    std::unique_ptr<RejectionSummary> m_summary;
+
+    // Each direction's overflow has its own lock, so threads overflowing in
+    // different directions don't contend.  A full overflow is swapped out
+    // under its lock and reinserted into its child without any lock held.
+    struct OverflowSlot
+    {
+        SpinLock spin{ locks::overflow };
+        std::unique_ptr<Overflow> overflow;
+        std::atomic<uint64_t> size{ 0 };
+
+        // Whether the overflow exists, which may be read without the lock.
+        std::atomic<bool> active{ false };
+    };
 
-    SpinLock m_spin;
-    std::vector<VoxelTube> m_grid;
-    MemBlock m_gridBlock;
+    std::array<OverflowSlot, 8> m_overflows;
+    std::atomic<uint64_t> m_overflowCount{ 0 };
 
-    SpinLock m_overflowSpin;
-    std::array<std::unique_ptr<Overflow>, 8> m_overflows;
-    uint64_t m_overflowCount = 0;
+    std::atomic<uint64_t> m_gridBytes;
+    std::atomic<uint64_t> m_overflowBytes;
 };
 
 } // namespace entwine
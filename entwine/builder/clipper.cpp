@@ -69,6 +69,7 @@ void Clipper::set(const ChunkKey& ck, Chunk* chunk)
 
 void Clipper::clip()
 {
+    m_inserted = 0;
     m_fast.fill(CachedChunk());
 
     for (
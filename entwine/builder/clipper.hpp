@@ -11,15 +11,22 @@
 #pragma once
 
 #include <array>
+#include <cassert>
 #include <limits>
+#include <memory>
+#include <mutex>
+#include <vector>
 
+#include <entwine/types/defs.hpp>
 #include <entwine/types/key.hpp>
+#include <entwine/util/unique.hpp>
 
 namespace entwine
 {
 
 class Chunk;
 class ChunkCache;
+class ClipperPool;
 
 struct CachedChunk
 {
@@ -44,8 +51,9 @@ inline bool operator<(const CachedChunk& a, const CachedChunk& b)
 class Clipper
 {
 public:
-    Clipper(ChunkCache& cache)
+    Clipper(ChunkCache& cache, ClipperPool* pool = nullptr)
         : m_cache(cache)
+        , m_pool(pool)
     {
         m_fast.fill(CachedChunk());
     }
@@ -56,8 +64,17 @@ public:
     void set(const ChunkKey& ck, Chunk* chunk);
     void clip();
 
+    // Points inserted through this clipper since it was last clipped.
+    void inserted(uint64_t np) { m_inserted += np; }
+    uint64_t sinceClip() const { return m_inserted; }
+
+    // The pool from which this clipper was acquired, if any.
+    ClipperPool* pool() const { return m_pool; }
+
 private:
     ChunkCache& m_cache;
+    ClipperPool* const m_pool;
+    uint64_t m_inserted = 0;
 
     using UsedMap = std::map<Xyz, Chunk*>;
     using AgedSet = std::set<Xyz>;
@@ -67,5 +84,61 @@ private:
     std::array<std::map<Xyz, Chunk*>, maxDepth> m_aged;
 };
 
+// Work threads keep their clippers, and so their working sets of chunks,
+// across sources rather than releasing everything as each source completes.
+// Adjacent tiles share chunks, so those chunks are only released by aging.
+// An idle clipper doesn't clip itself, so while the cache is short of memory,
+// running tasks age the idle working sets too - see age.
+//
+// Each running task holds one clipper, so with one clipper per work thread,
+// one is always available.
+class ClipperPool
+{
+public:
+    ClipperPool(ChunkCache& cache, uint64_t size)
+    {
+        for (uint64_t i(0); i < size; ++i)
+        {
+            m_idle.push_back(makeUnique<Clipper>(cache, this));
+        }
+    }
+
+    std::unique_ptr<Clipper> acquire()
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        assert(!m_idle.empty());
+        std::unique_ptr<Clipper> clipper(std::move(m_idle.back()));
+        m_idle.pop_back();
+        return clipper;
+    }
+
+    void release(std::unique_ptr<Clipper> clipper)
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_idle.push_back(std::move(clipper));
+    }
+
+    // Clip each idle clipper, as if it had reached its own clipping interval,
+    // so that chunks held only by idle clippers age out and may be evicted.
+    // If another thread is already doing so, this is a no-op.
+    void age()
+    {
+        std::unique_lock<std::mutex> lock(m_mutex, std::try_to_lock);
+        if (!lock) return;
+        for (auto& clipper : m_idle) clipper->clip();
+    }
+
+    // Release the chunks held by every clipper.  No clippers may be acquired.
+    void clear()
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_idle.clear();
+    }
+
+private:
+    std::mutex m_mutex;
+    std::vector<std::unique_ptr<Clipper>> m_idle;
+};
+
 } // namespace entwine
 
@@ -25,12 +25,41 @@ const uint64_t sleepCount(65536 * 32);
 // How many unreferenced chunks to keep alive in our chunk cache.
 const uint64_t cacheSize(64);
 
+// Compressed bytes of evicted chunks to hold in memory, if there is no memory
+// budget for the build, before spilling them to local scratch space.
+const uint64_t spillMemory(1ull << 30);
+
+// Writing chunks to the output is split from encoding them, since writes to
+// remote storage may be slow and mostly idle.  These threads perform the
+// writes, and at most uploadQueueSize encoded chunks may wait for them before
+// encoding blocks.  These are defaults for the corresponding build settings.
+const uint64_t uploadThreads(8);
+const uint64_t uploadQueueSize(16);
+
+// A trained zstandard dictionary holds at most dictionarySize bytes.  It is
+// trained from the smallest nodes of a build, up to dictionarySampleBytes of
+// their data - zstd suggests about a hundred times the dictionary size.
+const uint64_t dictionarySize(110 * 1024);
+const uint64_t dictionarySampleBytes(dictionarySize * 100);
+
 // When building, we are given a total thread count.  Because serialization is
 // more expensive than actually doing tree work, we'll allocate more threads to
 // the "clip" task than to the "work" task.  This parameter tunes the ratio of
 // work threads to clip threads.
 const float defaultWorkToClipRatio(0.33f);
 
+// Sources with fewer points than this will not be split into multiple point
+// ranges for concurrent insertion.  Each slice of a split source will contain
+// at least this many points.
+const uint64_t minPointsPerSlice(1 << 22);
+
+// A chunk which places fewer than one in saturationRatio of the points
+// passing through it, over a window of saturationWindow points, is considered
+// saturated.  Points which it would certainly reject are then rejected early,
+// without locking.
+const uint64_t saturationWindow(65536);
+const uint64_t saturationRatio(32);
+
 // Max number of nodes to store in a single hierarchy file.
 const uint64_t maxHierarchyNodesPerFile(32768);
 
@@ -13,6 +13,7 @@
 #include <cstdint>
 #include <map>
 
+#include <entwine/third/arbiter/arbiter.hpp>
 #include <entwine/types/key.hpp>
 #include <entwine/util/spin-lock.hpp>
 
@@ -32,7 +33,7 @@ struct Hierarchy
         return *this;
     }
 
-    mutable SpinLock spin;
+    mutable SpinLock spin{ locks::hierarchy };
     Map map = { { Dxyz(), 0 } };
 };
 
@@ -0,0 +1,209 @@
+/******************************************************************************
+* Copyright (c) 2020, Connor Manning (connor@hobu.co)
+*
+* Entwine -- Point cloud indexing
+*
+* Entwine is available under the terms of the LGPL2 license. See COPYING
+* for specific license text and more information.
+*
+******************************************************************************/
+
+#include <entwine/builder/insert-batch.hpp>
+
+#include <cmath>
+#include <cstring>
+#include <stdexcept>
+
+#include <entwine/util/unique.hpp>
+
+namespace entwine
+{
+
+namespace
+{
+
+template <typename T>
+void stampAs(
+    const std::vector<char*>& records,
+    const uint64_t offset,
+    uint64_t value,
+    const uint64_t step)
+{
+    for (char* record : records)
+    {
+        const T v(static_cast<T>(value));
+        std::memcpy(record + offset, &v, sizeof(T));
+        value += step;
+    }
+}
+
+double read(const char* record, const uint64_t offset)
+{
+    double v(0);
+    std::memcpy(&v, record + offset, sizeof(double));
+    return v;
+}
+
+void write(char* record, const uint64_t offset, const double v)
+{
+    std::memcpy(record + offset, &v, sizeof(double));
+}
+
+} // unnamed namespace
+
+InsertBatch::InsertBatch(const Metadata& metadata, const Origin origin)
+    : m_origin(origin)
+    , m_originId(field(metadata.absoluteSchema, "OriginId"))
+    , m_pointId(field(metadata.absoluteSchema, "PointId"))
+    , m_xOffset(getOffset(metadata.absoluteSchema, "X"))
+    , m_yOffset(getOffset(metadata.absoluteSchema, "Y"))
+    , m_zOffset(getOffset(metadata.absoluteSchema, "Z"))
+    , m_memoryPointSize(getPointSize(metadata.memorySchema))
+{
+    if (isScaledInMemory(metadata))
+    {
+        m_converter = makeUnique<RecordConverter>(
+                metadata.absoluteSchema,
+                metadata.memorySchema);
+    }
+}
+
+InsertBatch::Field InsertBatch::field(const Schema& schema, std::string name)
+{
+    Field f;
+    if (const Dimension* dim = maybeFind(schema, name))
+    {
+        f.type = dim->type;
+        f.offset = getOffset(schema, name);
+    }
+    return f;
+}
+
+uint64_t InsertBatch::gather(VectorPointTable& table, const uint64_t pointId)
+{
+    m_data.clear();
+    for (uint64_t i(0); i < table.numPoints(); ++i)
+    {
+        if (!table.skip(i)) m_data.push_back(table.getPoint(i));
+    }
+
+    stamp(m_originId, m_origin, 0);
+    stamp(m_pointId, pointId, 1);
+
+    const std::size_t n(m_data.size());
+    m_x.resize(n);
+    m_y.resize(n);
+    m_z.resize(n);
+
+    for (std::size_t i(0); i < n; ++i)
+    {
+        m_x[i] = read(m_data[i], m_xOffset);
+        m_y[i] = read(m_data[i], m_yOffset);
+        m_z[i] = read(m_data[i], m_zOffset);
+    }
+
+    return n;
+}
+
+void InsertBatch::stamp(
+        const Field& f,
+        const uint64_t value,
+        const uint64_t step)
+{
+    using T = Type;
+    switch (f.type)
+    {
+        case T::None: return;
+        case T::Signed8:
+            return stampAs<int8_t>(m_data, f.offset, value, step);
+        case T::Signed16:
+            return stampAs<int16_t>(m_data, f.offset, value, step);
+        case T::Signed32:
+            return stampAs<int32_t>(m_data, f.offset, value, step);
+        case T::Signed64:
+            return stampAs<int64_t>(m_data, f.offset, value, step);
+        case T::Unsigned8:
+            return stampAs<uint8_t>(m_data, f.offset, value, step);
+        case T::Unsigned16:
+            return stampAs<uint16_t>(m_data, f.offset, value, step);
+        case T::Unsigned32:
+            return stampAs<uint32_t>(m_data, f.offset, value, step);
+        case T::Unsigned64:
+            return stampAs<uint64_t>(m_data, f.offset, value, step);
+        case T::Float:
+            return stampAs<float>(m_data, f.offset, value, step);
+        case T::Double:
+            return stampAs<double>(m_data, f.offset, value, step);
+        default:
+            throw std::runtime_error("Invalid type: " + typeString(f.type));
+    }
+}
+
+void InsertBatch::clip(const ScaleOffset& so)
+{
+    const std::size_t n(m_data.size());
+    const auto apply([n](std::vector<double>& v, double scale, double offset)
+    {
+        for (std::size_t i(0); i < n; ++i)
+        {
+            v[i] = std::round((v[i] - offset) / scale) * scale + offset;
+        }
+    });
+
+    apply(m_x, so.scale.x, so.offset.x);
+    apply(m_y, so.scale.y, so.offset.y);
+    apply(m_z, so.scale.z, so.offset.z);
+
+    for (std::size_t i(0); i < n; ++i)
+    {
+        write(m_data[i], m_xOffset, m_x[i]);
+        write(m_data[i], m_yOffset, m_y[i]);
+        write(m_data[i], m_zOffset, m_z[i]);
+    }
+}
+
+void InsertBatch::filter(const Bounds& bounds)
+{
+    const std::size_t n(m_data.size());
+    m_keep.assign(n, 1);
+    bounds.filter(m_x.data(), m_y.data(), m_z.data(), n, m_keep.data());
+
+    std::size_t kept(0);
+    for (std::size_t i(0); i < n; ++i)
+    {
+        if (!m_keep[i]) continue;
+        m_x[kept] = m_x[i];
+        m_y[kept] = m_y[i];
+        m_z[kept] = m_z[i];
+        m_data[kept] = m_data[i];
+        ++kept;
+    }
+
+    m_x.resize(kept);
+    m_y.resize(kept);
+    m_z.resize(kept);
+    m_data.resize(kept);
+}
+
+void InsertBatch::convert()
+{
+    if (!m_converter) return;
+
+    m_records.resize(m_data.size() * m_memoryPointSize);
+    char* pos(m_records.data());
+    for (char*& data : m_data)
+    {
+        m_converter->convert(data, pos);
+        data = pos;
+        pos += m_memoryPointSize;
+    }
+}
+
+void InsertBatch::quantize(const Quantizer& quantizer)
+{
+    const std::size_t n(m_data.size());
+    m_lattice.resize(n);
+    quantizer.quantize(m_x.data(), m_y.data(), m_z.data(), n, m_lattice.data());
+}
+
+} // namespace entwine
@@ -0,0 +1,95 @@
+/******************************************************************************
+* Copyright (c) 2020, Connor Manning (connor@hobu.co)
+*
+* Entwine -- Point cloud indexing
+*
+* Entwine is available under the terms of the LGPL2 license. See COPYING
+* for specific license text and more information.
+*
+******************************************************************************/
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+#include <entwine/types/bounds.hpp>
+#include <entwine/types/defs.hpp>
+#include <entwine/types/dimension.hpp>
+#include <entwine/types/key.hpp>
+#include <entwine/types/metadata.hpp>
+#include <entwine/types/point.hpp>
+#include <entwine/types/record.hpp>
+#include <entwine/types/scale-offset.hpp>
+#include <entwine/types/vector-point-table.hpp>
+
+namespace entwine
+{
+
+// The points of a table being inserted, staged as one array per coordinate.
+// Coordinates are read straight from their offsets in each record rather than
+// through per-point field accessors, so that clipping, bounds filtering, and
+// quantization are flat loops over contiguous values which may be vectorized.
+class InsertBatch
+{
+public:
+    // Table records are laid out by the absolute schema of this metadata.
+    InsertBatch(const Metadata& metadata, Origin origin);
+
+    // Stamp OriginId and sequential PointIds, starting at pointId, into each
+    // point of the table which isn't skipped, and stage those points.  Returns
+    // the number of points staged.
+    uint64_t gather(VectorPointTable& table, uint64_t pointId);
+
+    // Round our coordinates, and those of the records, to this scale and
+    // offset.  Residents are compared against incoming points by reading
+    // their records, so both must hold the same value.
+    void clip(const ScaleOffset& so);
+
+    // Drop the points not contained by these bounds.
+    void filter(const Bounds& bounds);
+
+    void quantize(const Quantizer& quantizer);
+
+    // Move the remaining points into records of the in-memory schema, if it
+    // differs from that of the table.  Only then does data() refer to records
+    // in memory form.
+    void convert();
+
+    std::size_t size() const { return m_data.size(); }
+    Point point(std::size_t i) const { return Point(m_x[i], m_y[i], m_z[i]); }
+    char* data(std::size_t i) const { return m_data[i]; }
+    const Xyz& lattice(std::size_t i) const { return m_lattice[i]; }
+
+private:
+    struct Field
+    {
+        Type type = Type::None;
+        uint64_t offset = 0;
+    };
+
+    static Field field(const Schema& schema, std::string name);
+    void stamp(const Field& field, uint64_t value, uint64_t step);
+
+    const Origin m_origin;
+    const Field m_originId;
+    const Field m_pointId;
+    const uint64_t m_xOffset;
+    const uint64_t m_yOffset;
+    const uint64_t m_zOffset;
+
+    const uint64_t m_memoryPointSize;
+    std::unique_ptr<RecordConverter> m_converter;
+    std::vector<char> m_records;
+
+    std::vector<double> m_x;
+    std::vector<double> m_y;
+    std::vector<double> m_z;
+    std::vector<char*> m_data;
+    std::vector<uint8_t> m_keep;
+    std::vector<Xyz> m_lattice;
+};
+
+} // namespace entwine
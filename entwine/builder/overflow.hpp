@@ -10,40 +10,40 @@
 
 #pragma once
 
+#include <vector>
+
 #include <entwine/types/key.hpp>
-#include <entwine/types/vector-point-table.hpp>
-#include <entwine/types/voxel.hpp>
 
 namespace entwine
 {
 
 struct Overflow
 {
+    // An overflowed point and its record.  The point fully determines its key
+    // at any depth, so the key is only rebuilt when this entry is pushed into
+    // a child chunk.
     struct Entry
     {
-        Entry(const Key& key) : key(key) { }
-        Voxel voxel;
-        Key key;
+        Entry(const Point& point, char* data) : point(point), data(data) { }
+        Point point;
+        char* data = nullptr;
     };
 
-    Overflow(const ChunkKey& chunkKey, uint64_t pointSize)
-        : chunkKey(chunkKey)
-        , pointSize(pointSize)
-        , block(pointSize, 256)
-    { }
+    explicit Overflow(const ChunkKey& chunkKey) : chunkKey(chunkKey) { }
 
-    void insert(Voxel& voxel, Key& key)
+    // The record belongs to the chunk holding this overflow, and is handed to
+    // us by pointer rather than copied.
+    void insert(const Point& point, char* data)
     {
-        Entry entry(key);
-        entry.voxel.setData(block.next());
-        entry.voxel.initDeep(voxel.point(), voxel.data(), pointSize);
-        list.push_back(entry);
+        list.emplace_back(point, data);
     }
 
-    const ChunkKey chunkKey;
-    const uint64_t pointSize = 0;
+    uint64_t bytes() const
+    {
+        return sizeof(Overflow) + list.capacity() * sizeof(Entry);
+    }
 
-    MemBlock block;
+    const ChunkKey chunkKey;
     std::vector<Entry> list;
 };
 
@@ -0,0 +1,132 @@
+/******************************************************************************
+* Copyright (c) 2020, Connor Manning (connor@hobu.co)
+*
+* Entwine -- Point cloud indexing
+*
+* Entwine is available under the terms of the LGPL2 license. See COPYING
+* for specific license text and more information.
+*
+******************************************************************************/
+
+#include <entwine/builder/schedule.hpp>
+
+#include <algorithm>
+#include <cstdint>
+#include <stdexcept>
+#include <utility>
+#include <vector>
+
+namespace entwine
+{
+
+namespace
+{
+
+// Resolution of the Hilbert curve, per axis.
+const uint64_t hilbertBits(16);
+const uint64_t hilbertSide(1ull << hilbertBits);
+
+// Distance along the Hilbert curve of the given cell, for a curve covering
+// hilbertSide cells per side.
+uint64_t hilbertIndex(uint64_t x, uint64_t y)
+{
+    uint64_t d(0);
+    for (uint64_t s(hilbertSide / 2); s > 0; s /= 2)
+    {
+        const uint64_t rx((x & s) ? 1 : 0);
+        const uint64_t ry((y & s) ? 1 : 0);
+        d += s * s * ((3 * rx) ^ ry);
+
+        // Rotate the quadrant so the curve is continuous.
+        if (!ry)
+        {
+            if (rx)
+            {
+                x = hilbertSide - 1 - x;
+                y = hilbertSide - 1 - y;
+            }
+            std::swap(x, y);
+        }
+    }
+    return d;
+}
+
+uint64_t toCell(double v, double min, double width)
+{
+    if (width <= 0) return 0;
+    const double ratio((v - min) / width);
+    const double cell(ratio * hilbertSide);
+    if (!(cell > 0)) return 0;
+    return std::min<uint64_t>(cell, hilbertSide - 1);
+}
+
+} // unnamed namespace
+
+Schedule toSchedule(const std::string s)
+{
+    if (s == "manifest") return Schedule::Manifest;
+    if (s == "hilbert") return Schedule::Hilbert;
+    if (s == "largest") return Schedule::Largest;
+    throw std::runtime_error("Invalid schedule: " + s);
+}
+
+std::string toString(const Schedule s)
+{
+    if (s == Schedule::Manifest) return "manifest";
+    if (s == Schedule::Hilbert) return "hilbert";
+    if (s == Schedule::Largest) return "largest";
+    throw std::runtime_error("Invalid schedule enumeration");
+}
+
+namespace schedule
+{
+
+void apply(
+    const Schedule schedule,
+    const Manifest& manifest,
+    const Bounds& bounds,
+    OriginList& origins)
+{
+    if (schedule == Schedule::Manifest) return;
+
+    // Stable sorts, so ties keep their manifest order.
+    if (schedule == Schedule::Largest)
+    {
+        std::stable_sort(
+            origins.begin(),
+            origins.end(),
+            [&manifest](Origin a, Origin b)
+            {
+                return manifest.at(a).source.info.points >
+                    manifest.at(b).source.info.points;
+            });
+        return;
+    }
+
+    std::vector<std::pair<uint64_t, Origin>> keyed;
+    keyed.reserve(origins.size());
+    for (const Origin origin : origins)
+    {
+        const Point& mid(manifest.at(origin).source.info.bounds.mid());
+        const uint64_t x(toCell(mid.x, bounds.min().x, bounds.width()));
+        const uint64_t y(toCell(mid.y, bounds.min().y, bounds.depth()));
+        keyed.emplace_back(hilbertIndex(x, y), origin);
+    }
+
+    std::stable_sort(
+        keyed.begin(),
+        keyed.end(),
+        [](const std::pair<uint64_t, Origin>& a,
+            const std::pair<uint64_t, Origin>& b)
+        {
+            return a.first < b.first;
+        });
+
+    for (std::size_t i(0); i < keyed.size(); ++i)
+    {
+        origins[i] = keyed[i].second;
+    }
+}
+
+} // namespace schedule
+} // namespace entwine
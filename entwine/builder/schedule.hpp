@@ -0,0 +1,60 @@
+/******************************************************************************
+* Copyright (c) 2020, Connor Manning (connor@hobu.co)
+*
+* Entwine -- Point cloud indexing
+*
+* Entwine is available under the terms of the LGPL2 license. See COPYING
+* for specific license text and more information.
+*
+******************************************************************************/
+
+#pragma once
+
+#include <string>
+
+#include <entwine/types/bounds.hpp>
+#include <entwine/types/defs.hpp>
+#include <entwine/types/source.hpp>
+#include <entwine/util/json.hpp>
+
+namespace entwine
+{
+
+// The order in which sources are handed to the work threads.  Sources which are
+// active at the same time share the chunk cache, so this order determines how
+// often chunks are evicted and then reawakened.
+enum class Schedule
+{
+    // Manifest order, which typically follows the directory listing.
+    Manifest,
+
+    // Along a Hilbert curve through the centers of the source bounds, so that
+    // concurrently active sources touch nearby chunks.
+    Hilbert,
+
+    // By descending point count, so that the largest sources don't trail at
+    // the end of the build.
+    Largest
+};
+
+Schedule toSchedule(std::string s);
+std::string toString(Schedule s);
+inline void to_json(json& j, Schedule s) { j = toString(s); }
+inline void from_json(const json& j, Schedule& s)
+{
+    s = toSchedule(j.get<std::string>());
+}
+
+namespace schedule
+{
+
+// Reorder these manifest origins for insertion.  Bounds are the extents over
+// which to lay out the Hilbert curve.
+void apply(
+    Schedule schedule,
+    const Manifest& manifest,
+    const Bounds& bounds,
+    OriginList& origins);
+
+} // namespace schedule
+} // namespace entwine
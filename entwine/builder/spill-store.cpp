@@ -0,0 +1,317 @@
+/******************************************************************************
+* Copyright (c) 2020, Connor Manning (connor@hobu.co)
+*
+* Entwine -- Point cloud indexing
+*
+* Entwine is available under the terms of the LGPL2 license. See COPYING
+* for specific license text and more information.
+*
+******************************************************************************/
+
+#include <entwine/builder/spill-store.hpp>
+
+#include <algorithm>
+
+#include <entwine/builder/chunk.hpp>
+#include <entwine/builder/heuristics.hpp>
+#include <entwine/io/io.hpp>
+#include <entwine/io/shuffle.hpp>
+#include <entwine/types/metadata.hpp>
+#include <entwine/types/record.hpp>
+#include <entwine/types/vector-point-table.hpp>
+#include <entwine/util/io.hpp>
+#include <entwine/util/pool.hpp>
+#include <entwine/util/zstd.hpp>
+
+namespace entwine
+{
+
+namespace
+{
+
+// Spilled chunks are short-lived, so favor speed over ratio.
+const zstd::Options spillOptions(1);
+
+} // unnamed namespace
+
+SpillStore::SpillStore(
+    const Endpoints& endpoints,
+    const Metadata& metadata,
+    const uint64_t memoryBudget)
+    : m_endpoints(endpoints)
+    , m_metadata(metadata)
+    , m_memoryBudget(memoryBudget)
+{ }
+
+SpillStore::~SpillStore()
+{
+    for (const auto& p : m_entries)
+    {
+        if (!p.second.onDisk) continue;
+        const std::string path(getScratchPath(p.first, p.second.id));
+        arbiter::remove(m_endpoints.tmp.fullPath(path));
+    }
+}
+
+void SpillStore::put(const Dxyz& dxyz, std::unique_ptr<const Chunk> chunk)
+{
+    Entry entry;
+    entry.size = chunk->points() * getPointSize(m_metadata.memorySchema);
+    entry.chunk = std::move(chunk);
+    add(dxyz, std::move(entry));
+}
+
+void SpillStore::put(const Dxyz& dxyz, std::vector<char> records)
+{
+    Entry entry;
+    entry.size = records.size();
+    entry.raw = std::make_shared<std::vector<char>>(std::move(records));
+    add(dxyz, std::move(entry));
+}
+
+void SpillStore::add(const Dxyz& dxyz, Entry entry)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    assert(!m_entries.count(dxyz));
+    entry.id = m_nextId++;
+    m_entries[dxyz] = std::move(entry);
+}
+
+void SpillStore::settle(const Dxyz& dxyz)
+{
+    if (m_finished) return;
+
+    std::unique_lock<std::mutex> lock(m_mutex);
+    auto it(m_entries.find(dxyz));
+    if (it == m_entries.end()) return;
+    if (!it->second.chunk && !it->second.raw) return;
+
+    const uint64_t id(it->second.id);
+    const std::shared_ptr<const Chunk> chunk(it->second.chunk);
+    std::shared_ptr<const std::vector<char>> raw(it->second.raw);
+    lock.unlock();
+
+    if (chunk)
+    {
+        raw = std::make_shared<const std::vector<char>>(chunk->gather());
+    }
+
+    std::vector<char> compressed(
+        zstd::compress(raw->data(), raw->size(), spillOptions));
+
+    // If this entry was taken while we were compressing, there's nothing left
+    // to do.
+    lock.lock();
+    it = m_entries.find(dxyz);
+    if (it == m_entries.end() || it->second.id != id) return;
+
+    if (m_memory + compressed.size() <= m_memoryBudget)
+    {
+        m_memory += compressed.size();
+        it->second.compressed = std::move(compressed);
+        it->second.chunk.reset();
+        it->second.raw.reset();
+        return;
+    }
+
+    lock.unlock();
+
+    // Over our memory budget, so this one goes to local scratch space.  Until
+    // we mark the entry as on disk, a taker will use its chunk or raw records
+    // instead.
+    const std::string path(getScratchPath(dxyz, id));
+    m_endpoints.tmp.put(path, compressed);
+
+    lock.lock();
+    it = m_entries.find(dxyz);
+    if (it != m_entries.end() && it->second.id == id)
+    {
+        it->second.chunk.reset();
+        it->second.raw.reset();
+        it->second.onDisk = true;
+        return;
+    }
+
+    lock.unlock();
+    arbiter::remove(m_endpoints.tmp.fullPath(path));
+}
+
+bool SpillStore::take(const Dxyz& dxyz, std::vector<char>& records)
+{
+    std::unique_lock<std::mutex> lock(m_mutex);
+    auto it(m_entries.find(dxyz));
+    if (it == m_entries.end()) return false;
+
+    Entry entry(std::move(it->second));
+    m_entries.erase(it);
+    m_memory -= entry.compressed.size();
+    lock.unlock();
+
+    records = read(dxyz, entry);
+    return true;
+}
+
+void SpillStore::flush(Pool& pool)
+{
+    std::map<Dxyz, Entry> entries;
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        std::swap(entries, m_entries);
+        m_memory = 0;
+    }
+
+    if (m_metadata.dictionary) train(entries);
+
+    // Encoding is CPU-bound and runs on the caller's pool.  Encoded chunks are
+    // queued for the upload pool, whose bounded queue blocks encoding if the
+    // output can't keep up, which bounds the encoded data held in memory.
+    Pool upload(
+        m_metadata.internal.uploadThreads,
+        m_metadata.internal.uploadQueueSize);
+
+    for (auto& p : entries)
+    {
+        const Dxyz dxyz(p.first);
+        Entry& entry(p.second);
+
+        pool.add([this, dxyz, &entry, &upload]()
+        {
+            const auto encoded(
+                std::make_shared<const std::vector<char>>(
+                    encode(dxyz, read(dxyz, entry))));
+
+            const std::string filename(
+                dxyz.toString() +
+                getPostfix(m_metadata, dxyz.depth()) +
+                io::getExtension(m_metadata.dataType));
+
+            upload.add([this, filename, encoded]()
+            {
+                ensurePut(m_endpoints.data, filename, *encoded);
+            });
+        });
+    }
+
+    pool.await();
+    upload.join();
+}
+
+void SpillStore::train(std::map<Dxyz, Entry>& entries)
+{
+    io::zstandard::DictionaryCache& cache(*m_metadata.dictionary);
+
+    // A continued build keeps the dictionary its existing nodes were written
+    // with.
+    if (cache.get(m_metadata, m_endpoints)) return;
+
+    // The dictionary is meant for small nodes, so sample the smallest.
+    using Item = std::pair<const Dxyz, Entry>;
+    std::vector<Item*> items;
+    for (Item& item : entries) items.push_back(&item);
+    std::sort(
+        items.begin(),
+        items.end(),
+        [](const Item* a, const Item* b)
+        {
+            return a->second.size < b->second.size;
+        });
+
+    const RecordConverter& converter(*m_metadata.toStored);
+    std::vector<char> samples;
+    std::vector<std::size_t> sizes;
+
+    for (Item* item : items)
+    {
+        if (samples.size() >= heuristics::dictionarySampleBytes) break;
+
+        // Sampled entries are left raw for encoding.
+        Entry& entry(item->second);
+        std::vector<char> records(read(item->first, entry));
+
+        const uint64_t np(records.size() / converter.fromPointSize());
+        std::vector<char> packed(np * converter.toPointSize());
+        converter.convert(records.data(), packed.data(), np);
+
+        // Samples must look like what will actually be compressed.
+        if (m_metadata.zstdShuffle)
+        {
+            packed = io::shuffle::encode(m_metadata.schema, packed);
+        }
+
+        samples.insert(samples.end(), packed.begin(), packed.end());
+        sizes.push_back(packed.size());
+
+        entry.raw = std::make_shared<std::vector<char>>(std::move(records));
+    }
+
+    cache.train(m_metadata, m_endpoints, samples, sizes);
+}
+
+std::string SpillStore::getScratchPath(const Dxyz& dxyz, const uint64_t id)
+    const
+{
+    return "spill-" + dxyz.toString() + "-" + std::to_string(id) +
+        getPostfix(m_metadata) + ".zst";
+}
+
+std::vector<char> SpillStore::read(const Dxyz& dxyz, Entry& entry) const
+{
+    // A settle may be gathering this chunk too, which only reads it.
+    if (entry.chunk)
+    {
+        std::vector<char> records(entry.chunk->gather());
+        entry.chunk.reset();
+        return records;
+    }
+
+    if (entry.raw)
+    {
+        // Once the entry has left our map, a settle which still shares these
+        // records is the only other owner - if there is none, take them.
+        std::vector<char> records;
+        if (entry.raw.use_count() == 1) records = std::move(*entry.raw);
+        else records = *entry.raw;
+        entry.raw.reset();
+        return records;
+    }
+
+    if (entry.onDisk)
+    {
+        const std::string path(getScratchPath(dxyz, entry.id));
+        entry.compressed = m_endpoints.tmp.getBinary(path);
+        arbiter::remove(m_endpoints.tmp.fullPath(path));
+        entry.onDisk = false;
+    }
+
+    std::vector<char> records(zstd::decompress(entry.compressed, entry.size));
+    std::vector<char>().swap(entry.compressed);
+    return records;
+}
+
+std::vector<char> SpillStore::encode(
+    const Dxyz& dxyz,
+    std::vector<char> records) const
+{
+    const uint64_t pointSize(getPointSize(m_metadata.memorySchema));
+
+    auto layout = toLayout(m_metadata.memorySchema);
+    BlockPointTable table(layout);
+    table.reserve(records.size() / pointSize);
+    for (uint64_t pos(0); pos < records.size(); pos += pointSize)
+    {
+        table.insert(records.data() + pos);
+    }
+
+    const auto filename =
+        dxyz.toString() + getPostfix(m_metadata, dxyz.depth());
+
+    return io::encode(
+        m_metadata.dataType,
+        m_metadata,
+        m_endpoints,
+        filename,
+        table,
+        m_metadata.quantizer.bounds(dxyz.position(), dxyz.depth()));
+}
+
+} // namespace entwine
@@ -0,0 +1,113 @@
+/******************************************************************************
+* Copyright (c) 2020, Connor Manning (connor@hobu.co)
+*
+* Entwine -- Point cloud indexing
+*
+* Entwine is available under the terms of the LGPL2 license. See COPYING
+* for specific license text and more information.
+*
+******************************************************************************/
+
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include <entwine/types/endpoints.hpp>
+#include <entwine/types/key.hpp>
+
+namespace entwine
+{
+
+class Chunk;
+struct Metadata;
+class Pool;
+
+// Holds the points of chunks evicted from the ChunkCache, so that reawakening
+// a chunk doesn't round-trip through the output encoding and storage.  Evicted
+// chunks are compressed with a fast codec and held in memory up to a budget,
+// past which they are written to local scratch space.  Each chunk is encoded
+// to its final data type and written to the output once, at flush time.
+class SpillStore
+{
+public:
+    SpillStore(
+        const Endpoints& endpoints,
+        const Metadata& metadata,
+        uint64_t memoryBudget);
+    ~SpillStore();
+
+    // Store an evicted chunk, or the raw records, in the in-memory schema, of
+    // one.  This only registers them, so it is cheap enough to call while
+    // holding the chunk's lock - once it returns, the chunk may be taken.
+    void put(const Dxyz& dxyz, std::unique_ptr<const Chunk> chunk);
+    void put(const Dxyz& dxyz, std::vector<char> records);
+
+    // Gather and compress the records stored by put, if they haven't been
+    // taken in the meantime, and move them to scratch space if we are over
+    // budget.  This does the expensive work of a put, so it should be called
+    // without holding the chunk's lock.
+    void settle(const Dxyz& dxyz);
+
+    // Called once no spilled chunk will be taken back, after which settle
+    // leaves records raw for flush to encode directly, rather than compressing
+    // them only to decompress them again.
+    void finish() { m_finished = true; }
+
+    // If this chunk has been spilled, remove it from the store and return its
+    // records.
+    bool take(const Dxyz& dxyz, std::vector<char>& records);
+
+    // Write every spilled chunk to the output.  Chunks are encoded on the
+    // given pool and written by a separate pool, so a slow output doesn't
+    // leave the encoding threads idle.
+    void flush(Pool& pool);
+
+private:
+    struct Entry
+    {
+        // A chunk, or records, which have not yet been settled.  These are
+        // shared so that settle may gather and compress them without holding
+        // our lock.
+        std::shared_ptr<const Chunk> chunk;
+        std::shared_ptr<std::vector<char>> raw;
+
+        // The size of the raw records, so decompression can allocate once.
+        uint64_t size = 0;
+
+        // Empty if this entry is raw or on disk.
+        std::vector<char> compressed;
+        bool onDisk = false;
+
+        // Distinguishes this entry from others for the same chunk, which may
+        // have been taken and spilled again while this one was settling.
+        uint64_t id = 0;
+    };
+
+    // Train the dataset's zstandard dictionary from the smallest entries,
+    // unless one already exists.
+    void train(std::map<Dxyz, Entry>& entries);
+
+    void add(const Dxyz& dxyz, Entry entry);
+
+    std::string getScratchPath(const Dxyz& dxyz, uint64_t id) const;
+    std::vector<char> read(const Dxyz& dxyz, Entry& entry) const;
+    std::vector<char> encode(const Dxyz& dxyz, std::vector<char> records) const;
+
+    const Endpoints& m_endpoints;
+    const Metadata& m_metadata;
+    const uint64_t m_memoryBudget;
+
+    std::mutex m_mutex;
+    std::map<Dxyz, Entry> m_entries;
+    uint64_t m_memory = 0;
+    uint64_t m_nextId = 0;
+    std::atomic<bool> m_finished { false };
+};
+
+} // namespace entwine
@@ -0,0 +1,234 @@
+/******************************************************************************
+* Copyright (c) 2019, Connor Manning (connor@hobu.co)
+*
+* Entwine -- Point cloud indexing
+*
+* Entwine is available under the terms of the LGPL2 license. See COPYING
+* for specific license text and more information.
+*
+******************************************************************************/
+
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <bitset>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <limits>
+#include <vector>
+
+#include <entwine/util/spin-lock.hpp>
+
+namespace entwine
+{
+
+// The voxels sharing an XY position within a chunk, keyed by their Z position.
+// This is a small open-addressed table of record pointers - the coordinates
+// of a resident voxel are read back from its record rather than stored again.
+class VoxelTube
+{
+public:
+    // Returns the record slot for this Z position.  A null slot has just been
+    // created and must be filled by the caller.
+    char*& at(uint32_t z)
+    {
+        if ((m_size + 1) * 4 > m_cells.size() * 3) grow();
+
+        Cell& cell(find(z));
+        if (!cell.data)
+        {
+            cell.z = z;
+            ++m_size;
+        }
+        return cell.data;
+    }
+
+    uint64_t bytes() const { return m_cells.capacity() * sizeof(Cell); }
+    uint32_t size() const { return m_size; }
+
+    // Calls f(z, data) for each resident voxel.
+    template<typename F>
+    void each(F f) const
+    {
+        for (const Cell& cell : m_cells) if (cell.data) f(cell.z, cell.data);
+    }
+
+private:
+    struct Cell
+    {
+        uint32_t z = 0;
+        char* data = nullptr;
+    };
+
+    // Positions within a tube are contiguous, so their low bits hash well.
+    Cell& find(uint32_t z)
+    {
+        const std::size_t mask(m_cells.size() - 1);
+        std::size_t i(z & mask);
+        while (m_cells[i].data && m_cells[i].z != z) i = (i + 1) & mask;
+        return m_cells[i];
+    }
+
+    void grow()
+    {
+        std::vector<Cell> cells(m_cells.empty() ? 4 : m_cells.size() * 2);
+        std::swap(cells, m_cells);
+        for (const Cell& cell : cells) if (cell.data) find(cell.z) = cell;
+    }
+
+    std::vector<Cell> m_cells;
+    uint32_t m_size = 0;
+};
+
+// A sparse span-by-span grid of voxel tubes.  Tubes are only allocated once a
+// point lands at their XY position, in blocks of 64 adjacent positions which
+// share a lock and an occupancy bitmap.
+class VoxelGrid
+{
+public:
+    struct Block
+    {
+        SpinLock spin{ locks::voxel };
+        uint64_t occupied = 0;
+        std::vector<VoxelTube> tubes;
+    };
+
+    explicit VoxelGrid(uint64_t span) : m_blocks((span * span + 63) / 64) { }
+
+    Block& block(uint64_t i) { return m_blocks[i / 64]; }
+
+    // The block containing this position must be locked by the caller.
+    static VoxelTube& tube(Block& block, uint64_t i)
+    {
+        const uint64_t bit(uint64_t(1) << (i % 64));
+        const std::size_t rank(
+            std::bitset<64>(block.occupied & (bit - 1)).count());
+
+        if (!(block.occupied & bit))
+        {
+            block.occupied |= bit;
+            block.tubes.emplace(block.tubes.begin() + rank);
+        }
+
+        return block.tubes[rank];
+    }
+
+    // Like tube, but returns null rather than creating an empty tube.
+    static const VoxelTube* find(const Block& block, uint64_t i)
+    {
+        const uint64_t bit(uint64_t(1) << (i % 64));
+        if (!(block.occupied & bit)) return nullptr;
+
+        const std::size_t rank(
+            std::bitset<64>(block.occupied & (bit - 1)).count());
+        return &block.tubes[rank];
+    }
+
+    // Not thread-safe.  Calls f(data) for the record of each resident voxel.
+    template<typename F>
+    void each(F f) const
+    {
+        for (const Block& block : m_blocks)
+        {
+            for (const VoxelTube& tube : block.tubes)
+            {
+                tube.each([&f](uint32_t, const char* data) { f(data); });
+            }
+        }
+    }
+
+    // Not thread-safe - for accounting once insertion into this grid is done.
+    uint64_t bytes() const
+    {
+        uint64_t total(m_blocks.capacity() * sizeof(Block));
+        for (const Block& block : m_blocks)
+        {
+            total += block.tubes.capacity() * sizeof(VoxelTube);
+            for (const VoxelTube& tube : block.tubes) total += tube.bytes();
+        }
+        return total;
+    }
+
+private:
+    std::vector<Block> m_blocks;
+};
+
+// A summary of each tube in a grid which may be read without locking, used to
+// reject points early: the range of Z positions its residents occupy, if that
+// range has no gaps, and an upper bound on the squared distance of any
+// resident from its voxel's center.  A point within that range which is at
+// least that far from its own voxel's center can neither fill a voxel nor
+// displace its resident.
+class RejectionSummary
+{
+public:
+    explicit RejectionSummary(uint64_t span)
+        : m_span(span)
+        , m_tubes(span * span)
+    {
+        for (auto& tube : m_tubes) tube = open;
+    }
+
+    bool rejects(uint64_t i, uint32_t z, double sqDist) const
+    {
+        const uint64_t v(m_tubes[i]);
+        const uint32_t local(z % m_span);
+        const uint32_t lo(v >> 48);
+        const uint32_t hi((v >> 32) & 0xffff);
+        const uint32_t bits(v & 0xffffffff);
+
+        float worst(0);
+        std::memcpy(&worst, &bits, sizeof(float));
+        return local >= lo && local <= hi && sqDist >= worst;
+    }
+
+    // Recompute the entry for the tube at position i, which must be locked.
+    // Here, sqDist(z, data) is the squared distance of a resident from the
+    // center of its voxel.
+    template<typename F>
+    void update(uint64_t i, const VoxelTube& tube, F sqDist)
+    {
+        uint32_t lo(std::numeric_limits<uint32_t>::max());
+        uint32_t hi(0);
+        double worst(0);
+
+        tube.each([&](uint32_t z, const char* data)
+        {
+            const uint32_t local(z % m_span);
+            lo = std::min(lo, local);
+            hi = std::max(hi, local);
+            worst = std::max(worst, sqDist(z, data));
+        });
+
+        if (!tube.size() || hi - lo + 1 != tube.size())
+        {
+            m_tubes[i] = open;
+            return;
+        }
+
+        // Round up, so this stays an upper bound.
+        float w(static_cast<float>(worst));
+        if (w < worst) w = std::nextafter(w, std::numeric_limits<float>::max());
+
+        uint32_t bits(0);
+        std::memcpy(&bits, &w, sizeof(float));
+        m_tubes[i] =
+            (uint64_t(lo) << 48) | (uint64_t(hi) << 32) | uint64_t(bits);
+    }
+
+    uint64_t bytes() const
+    {
+        return sizeof(RejectionSummary) + m_tubes.size() * sizeof(uint64_t);
+    }
+
+private:
+    // An empty range, which rejects nothing.
+    static constexpr uint64_t open = uint64_t(0xffff) << 48;
+
+    const uint64_t m_span;
+    std::vector<std::atomic<uint64_t>> m_tubes;
+};
+
+} // namespace entwine
@@ -11,12 +11,10 @@
 #include <entwine/io/binary.hpp>
 
 #include <algorithm>
+#include <cassert>
 
-#include <pdal/PointRef.hpp>
-
-#include <entwine/types/dimension.hpp>
 #include <entwine/types/metadata.hpp>
-#include <entwine/types/scale-offset.hpp>
+#include <entwine/types/record.hpp>
 #include <entwine/util/io.hpp>
 
 namespace entwine
@@ -26,15 +24,22 @@ namespace io
 namespace binary
 {
 
-void write(
+namespace
+{
+
+// Points converted at a time while streaming packed records.
+const uint64_t stagingPoints(4096);
+
+} // unnamed namespace
+
+std::vector<char> encode(
     const Metadata& metadata,
     const Endpoints& endpoints,
     const std::string filename,
     BlockPointTable& table,
     const Bounds bounds)
 {
-    const auto packed = pack(metadata, table);
-    ensurePut(endpoints.data, filename + ".bin", packed);
+    return pack(metadata, table);
 }
 
 void read(
@@ -49,57 +54,50 @@ void read(
 
 std::vector<char> pack(const Metadata& m, BlockPointTable& src)
 {
+    std::vector<char> dst;
+    dst.reserve(src.size() * m.toStored->toPointSize());
+    pack(m, src, [&dst](const char* pos, std::size_t size)
+    {
+        dst.insert(dst.end(), pos, pos + size);
+    });
+    return dst;
+}
+
+void pack(const Metadata& m, BlockPointTable& src, const PackSink& f)
+{
+    const RecordConverter& converter(*m.toStored);
     const uint64_t np(src.size());
+    const uint64_t pointSize(converter.toPointSize());
 
-    auto layout = toLayout(m.schema);
-    VectorPointTable dst(layout, np);
-
-    // Handle XYZ separately since we might need to scale/offset them.
-    const Schema others = omit(m.schema, { "X", "Y", "Z" });
-    struct DimReg { DimId id; DimType type; uint64_t offset; };
-    const auto registrations = std::accumulate(
-        others.begin(),
-        others.end(),
-        std::vector<DimReg>(),
-        [&layout](std::vector<DimReg> v, const Dimension& d)
+    if (converter.identity())
+    {
+        const char* begin(nullptr);
+        const char* end(nullptr);
+        for (uint64_t i(0); i < np; ++i)
         {
-            const DimId id = layout.findDim(d.name);
-            v.push_back({ id, d.type, layout.dimOffset(id) });
-            return v;
-        });
-
-    pdal::PointRef srcPr(src, 0);
-    pdal::PointRef dstPr(dst, 0);
-
-    Point p;
-
-    const auto so = getScaleOffset(m.schema);
+            const char* record(src.getPoint(i));
+            if (record != end)
+            {
+                if (begin != end) f(begin, end - begin);
+                begin = record;
+            }
+            end = record + pointSize;
+        }
+        if (begin != end) f(begin, end - begin);
+        return;
+    }
 
-    for (uint64_t i(0); i < np; ++i)
+    std::vector<char> staging(std::min(np, stagingPoints) * pointSize);
+    for (uint64_t i(0); i < np; )
     {
-        srcPr.setPointId(i);
-        dstPr.setPointId(i);
-        char* pos(dst.getPoint(i));
-
-        // Handle XYZ, applying transformation if needed.
-        p.x = srcPr.getFieldAs<double>(DimId::X);
-        p.y = srcPr.getFieldAs<double>(DimId::Y);
-        p.z = srcPr.getFieldAs<double>(DimId::Z);
-
-        if (so) p = Point::scale(p, so->scale, so->offset).round();
-
-        dstPr.setField(DimId::X, p.x);
-        dstPr.setField(DimId::Y, p.y);
-        dstPr.setField(DimId::Z, p.z);
-
-        // Handle the rest of the dimensions.
-        for (const auto& dim : registrations)
+        const uint64_t n(std::min(np - i, stagingPoints));
+        char* pos(staging.data());
+        for (uint64_t end(i + n); i < end; ++i, pos += pointSize)
         {
-            srcPr.getField(pos + dim.offset, dim.id, dim.type);
+            converter.convert(src.getPoint(i), pos);
         }
+        f(staging.data(), n * pointSize);
     }
-
-    return dst.data();
 }
 
 void unpack(
@@ -107,53 +105,11 @@ void unpack(
     VectorPointTable& dst,
     std::vector<char>&& packed)
 {
-    auto scaledLayout = toLayout(m.schema);
-    VectorPointTable src(scaledLayout, std::move(packed));
-
-    const uint64_t np(src.capacity());
+    const RecordConverter& converter(*m.fromStored);
+    const uint64_t np(packed.size() / converter.fromPointSize());
     assert(np == dst.capacity());
 
-    // For reading, our destination schema will always be normalized (i.e. XYZ
-    // as doubles).  So we can just copy the full dimension list and then
-    // transform XYZ in place, if necessary.
-    auto absoluteLayout = toLayout(m.absoluteSchema);
-    pdal::DimTypeList dimTypes(absoluteLayout.dimTypes());
-
-    pdal::PointRef srcPr(src, 0);
-    pdal::PointRef dstPr(dst, 0);
-
-    Point p;
-
-    const auto so = getScaleOffset(m.schema);
-
-    for (uint64_t i(0); i < np; ++i)
-    {
-        srcPr.setPointId(i);
-        dstPr.setPointId(i);
-        char* pos(dst.getPoint(i));
-
-        for (const pdal::DimType& dim : dimTypes)
-        {
-            srcPr.getField(
-                    pos + absoluteLayout.dimOffset(dim.m_id),
-                    dim.m_id,
-                    dim.m_type);
-        }
-
-        if (so)
-        {
-            p.x = dstPr.getFieldAs<double>(DimId::X);
-            p.y = dstPr.getFieldAs<double>(DimId::Y);
-            p.z = dstPr.getFieldAs<double>(DimId::Z);
-
-            p = Point::unscale(p, so->scale, so->offset);
-
-            dstPr.setField(DimId::X, p.x);
-            dstPr.setField(DimId::Y, p.y);
-            dstPr.setField(DimId::Z, p.z);
-        }
-    }
-
+    converter.convert(packed.data(), dst.data().data(), np);
     dst.clear(np);
 }
 
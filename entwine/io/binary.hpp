@@ -10,6 +10,8 @@
 
 #pragma once
 
+#include <cstddef>
+#include <functional>
 #include <string>
 #include <vector>
 
@@ -27,13 +29,22 @@ namespace io
 namespace binary
 {
 
+// Receives packed records in order, as contiguous byte spans.
+using PackSink = std::function<void(const char* pos, std::size_t size)>;
+
 std::vector<char> pack(const Metadata& metadata, BlockPointTable& src);
+
+// Stream the packed form of src to the sink without materializing all of it.
+// Records which need no conversion and lie end to end in memory are passed
+// through in place, others are converted through a small staging buffer.
+void pack(const Metadata& metadata, BlockPointTable& src, const PackSink& f);
+
 void unpack(
     const Metadata& m,
     VectorPointTable& dst,
     std::vector<char>&& buffer);
 
-void write(
+std::vector<char> encode(
     const Metadata& Metadata,
     const Endpoints& endpoints,
     const std::string filename,
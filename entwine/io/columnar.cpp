@@ -0,0 +1,283 @@
+/******************************************************************************
+* Copyright (c) 2020, Connor Manning (connor@hobu.co)
+*
+* Entwine -- Point cloud indexing
+*
+* Entwine is available under the terms of the LGPL2 license. See COPYING
+* for specific license text and more information.
+*
+******************************************************************************/
+
+#include <entwine/io/columnar.hpp>
+
+#include <algorithm>
+#include <cstring>
+#include <limits>
+#include <stdexcept>
+
+#include <entwine/io/shuffle.hpp>
+#include <entwine/types/metadata.hpp>
+#include <entwine/types/record.hpp>
+#include <entwine/util/io.hpp>
+#include <entwine/util/zstd.hpp>
+
+namespace entwine
+{
+namespace io
+{
+namespace columnar
+{
+
+namespace
+{
+
+const std::string extension(".col");
+
+struct Column
+{
+    uint64_t offset = 0;
+    uint64_t size = 0;
+};
+
+uint64_t getIndexSize(const Schema& schema)
+{
+    return 2 * sizeof(uint64_t) + schema.size() * sizeof(Column);
+}
+
+uint64_t readUint64(const char* pos)
+{
+    uint64_t v;
+    std::memcpy(&v, pos, sizeof(v));
+    return v;
+}
+
+void writeUint64(char* pos, const uint64_t v)
+{
+    std::memcpy(pos, &v, sizeof(v));
+}
+
+// Parse the index at the front of a node, returning its point count.  Columns
+// must follow the index in order without overlapping, and must end by the end
+// of the node, if it is known.
+uint64_t readIndex(
+    const Schema& schema,
+    const std::vector<char>& data,
+    std::vector<Column>& columns,
+    const uint64_t end = std::numeric_limits<uint64_t>::max())
+{
+    if (data.size() < getIndexSize(schema))
+    {
+        throw std::runtime_error("Invalid columnar index");
+    }
+
+    const uint64_t np(readUint64(data.data()));
+    if (readUint64(data.data() + sizeof(uint64_t)) != schema.size())
+    {
+        throw std::runtime_error("Columnar index does not match the schema");
+    }
+
+    columns.resize(schema.size());
+    const char* pos(data.data() + 2 * sizeof(uint64_t));
+    uint64_t prev(getIndexSize(schema));
+    for (Column& column : columns)
+    {
+        column.offset = readUint64(pos);
+        column.size = readUint64(pos + sizeof(uint64_t));
+        pos += sizeof(Column);
+
+        if (
+            column.offset < prev ||
+            column.offset > end ||
+            column.size > end - column.offset)
+        {
+            throw std::runtime_error("Invalid columnar index");
+        }
+        prev = column.offset + column.size;
+    }
+
+    return np;
+}
+
+} // unnamed namespace
+
+std::vector<char> encode(
+    const Metadata& metadata,
+    const Endpoints& endpoints,
+    const std::string filename,
+    BlockPointTable& table,
+    const Bounds bounds)
+{
+    const Schema& schema(metadata.schema);
+    const uint64_t np(table.size());
+
+    // The shuffled node already lays out each dimension contiguously, in
+    // schema order, so each column is a slice of it.
+    const std::vector<char> shuffled(
+        shuffle::encode(schema, binary::pack(metadata, table)));
+
+    zstd::Options options(metadata.internal.zstdOptions);
+    options.threads = 0;
+
+    std::vector<char> out(getIndexSize(schema));
+    writeUint64(out.data(), np);
+    writeUint64(out.data() + sizeof(uint64_t), schema.size());
+
+    const char* pos(shuffled.data());
+    for (std::size_t i(0); i < schema.size(); ++i)
+    {
+        const uint64_t bytes(np * size(schema[i].type));
+        const std::vector<char> compressed(zstd::compress(pos, bytes, options));
+        pos += bytes;
+
+        // The output may reallocate as it grows, so index by position.
+        const uint64_t offset(out.size());
+        out.insert(out.end(), compressed.begin(), compressed.end());
+
+        char* index(out.data() + 2 * sizeof(uint64_t) + i * sizeof(Column));
+        writeUint64(index, offset);
+        writeUint64(index + sizeof(uint64_t), compressed.size());
+    }
+
+    return out;
+}
+
+void read(
+    const Metadata& metadata,
+    const Endpoints& endpoints,
+    const std::string filename,
+    VectorPointTable& table)
+{
+    StringList dimensions;
+    for (const Dimension& d : metadata.schema) dimensions.push_back(d.name);
+    readDimensions(metadata, endpoints, filename, table, dimensions);
+}
+
+void readDimensions(
+    const Metadata& metadata,
+    const Endpoints& endpoints,
+    const std::string filename,
+    VectorPointTable& table,
+    const StringList& dimensions)
+{
+    const Schema& schema(metadata.schema);
+    const arbiter::Endpoint& ep(endpoints.data);
+    const std::string path(filename + extension);
+
+    std::vector<bool> wanted(schema.size(), false);
+    for (const std::string& name : dimensions)
+    {
+        const auto it(
+            std::find_if(
+                schema.begin(),
+                schema.end(),
+                [&name](const Dimension& d) { return d.name == name; }));
+
+        if (it == schema.end())
+        {
+            throw std::runtime_error("Invalid dimension: " + name);
+        }
+        wanted[it - schema.begin()] = true;
+    }
+
+    // If every column is wanted, a single read of the whole node is cheapest.
+    const bool all(std::all_of(wanted.begin(), wanted.end(), [](bool b)
+    {
+        return b;
+    }));
+
+    std::vector<char> data(
+        all
+            ? ensureGetBinary(ep, path)
+            : ensureGetRange(ep, path, 0, getIndexSize(schema)));
+
+    std::vector<Column> columns;
+    const uint64_t np(
+        all
+            ? readIndex(schema, data, columns, data.size())
+            : readIndex(schema, data, columns));
+    if (np != table.capacity())
+    {
+        throw std::runtime_error("Invalid columnar point count");
+    }
+
+    // Reassemble stored records, straight into the table if they are also our
+    // in-memory records.
+    const RecordConverter& converter(*metadata.fromStored);
+    const uint64_t pointSize(converter.fromPointSize());
+    std::vector<char> rows;
+    char* dst(nullptr);
+    if (converter.identity())
+    {
+        std::fill(table.data().begin(), table.data().end(), 0);
+        dst = table.data().data();
+    }
+    else
+    {
+        rows.resize(np * pointSize, 0);
+        dst = rows.data();
+    }
+
+    std::vector<char> shuffled;
+    std::vector<char> column;
+    uint64_t offset(0);
+    std::size_t i(0);
+    while (i < schema.size())
+    {
+        if (!wanted[i])
+        {
+            offset += size(schema[i].type);
+            ++i;
+            continue;
+        }
+
+        // Fetch runs of adjacent wanted columns together.
+        std::size_t end(i);
+        while (end < schema.size() && wanted[end]) ++end;
+
+        const uint64_t begin(columns[i].offset);
+        const std::vector<char> fetched(
+            all
+                ? std::vector<char>()
+                : ensureGetRange(
+                    ep,
+                    path,
+                    begin,
+                    columns[end - 1].offset + columns[end - 1].size));
+
+        for ( ; i < end; ++i)
+        {
+            const Dimension& d(schema[i]);
+            const uint64_t bytes(size(d.type));
+            const char* pos(
+                all
+                    ? data.data() + columns[i].offset
+                    : fetched.data() + columns[i].offset - begin);
+
+            shuffled.resize(np * bytes);
+            column.resize(np * bytes);
+            zstd::decompress(
+                pos,
+                columns[i].size,
+                shuffled.data(),
+                shuffled.size());
+            shuffle::decode({ d }, shuffled.data(), column.data(), np);
+
+            for (uint64_t p(0); p < np; ++p)
+            {
+                std::memcpy(
+                    dst + p * pointSize + offset,
+                    column.data() + p * bytes,
+                    bytes);
+            }
+
+            offset += bytes;
+        }
+    }
+
+    if (converter.identity()) table.clear(np);
+    else binary::unpack(metadata, table, std::move(rows));
+}
+
+} // namespace columnar
+} // namespace io
+} // namespace entwine
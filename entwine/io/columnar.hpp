@@ -0,0 +1,65 @@
+/******************************************************************************
+* Copyright (c) 2020, Connor Manning (connor@hobu.co)
+*
+* Entwine -- Point cloud indexing
+*
+* Entwine is available under the terms of the LGPL2 license. See COPYING
+* for specific license text and more information.
+*
+******************************************************************************/
+
+#pragma once
+
+#include <string>
+#include <vector>
+
+#include <entwine/io/binary.hpp>
+#include <entwine/types/defs.hpp>
+
+namespace entwine
+{
+namespace io
+{
+namespace columnar
+{
+
+// Nodes are stored as a separately compressed block per dimension, in schema
+// order, following a small index:
+//
+//      uint64      point count
+//      uint64      column count
+//      {
+//          uint64  offset of the column block from the start of the file
+//          uint64  compressed size of the column block
+//      } for each column
+//
+// Each column is transformed as by the shuffle filter before it is zstd
+// compressed, and points are sorted by GpsTime if it exists.  Since the
+// index size follows from the schema, a reader may fetch the index and then
+// only the columns it needs.
+
+std::vector<char> encode(
+    const Metadata& metadata,
+    const Endpoints& endpoints,
+    const std::string filename,
+    BlockPointTable& table,
+    const Bounds bounds);
+
+void read(
+    const Metadata& metadata,
+    const Endpoints& endpoints,
+    std::string filename,
+    VectorPointTable& table);
+
+// Read only the given dimensions, leaving the others zeroed.  Columns are
+// fetched with ranged reads where the endpoint supports them.
+void readDimensions(
+    const Metadata& metadata,
+    const Endpoints& endpoints,
+    std::string filename,
+    VectorPointTable& table,
+    const StringList& dimensions);
+
+} // namespace columnar
+} // namespace io
+} // namespace entwine
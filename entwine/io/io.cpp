@@ -12,6 +12,8 @@
 
 #include <stdexcept>
 
+#include <entwine/util/io.hpp>
+
 namespace entwine
 {
 namespace io
@@ -22,6 +24,7 @@ Type toType(const std::string s)
     if (s == "binary") return Type::Binary;
     if (s == "laszip") return Type::Laszip;
     if (s == "zstandard") return Type::Zstandard;
+    if (s == "columnar") return Type::Columnar;
     throw std::runtime_error("Invalid data IO type: " + s);
 }
 
@@ -30,8 +33,70 @@ std::string toString(const Type t)
     if (t == Type::Binary) return "binary";
     if (t == Type::Laszip) return "laszip";
     if (t == Type::Zstandard) return "zstandard";
+    if (t == Type::Columnar) return "columnar";
+    throw std::runtime_error("Invalid data IO enumeration");
+}
+
+std::string getExtension(const Type t)
+{
+    if (t == Type::Binary) return ".bin";
+    if (t == Type::Laszip) return ".laz";
+    if (t == Type::Zstandard) return ".zst";
+    if (t == Type::Columnar) return ".col";
     throw std::runtime_error("Invalid data IO enumeration");
 }
 
+namespace
+{
+
+const std::string dictionarySuffix("-dictionary");
+const std::string shuffleSuffix("-shuffle");
+
+bool stripSuffix(std::string& s, const std::string& suffix)
+{
+    if (s.size() <= suffix.size()) return false;
+    if (s.compare(s.size() - suffix.size(), suffix.size(), suffix)) return false;
+    s.erase(s.size() - suffix.size());
+    return true;
+}
+
+} // unnamed namespace
+
+EptDataType toEptDataType(std::string s)
+{
+    EptDataType t;
+    t.zstdShuffle = stripSuffix(s, shuffleSuffix);
+    t.zstdDictionary = stripSuffix(s, dictionarySuffix);
+    t.type = toType(s);
+
+    if ((t.zstdShuffle || t.zstdDictionary) && t.type != Type::Zstandard)
+    {
+        throw std::runtime_error("Invalid data IO type: " + toString(t));
+    }
+    return t;
+}
+
+std::string toString(const EptDataType& t)
+{
+    std::string s(toString(t.type));
+    if (t.zstdDictionary) s += dictionarySuffix;
+    if (t.zstdShuffle) s += shuffleSuffix;
+    return s;
+}
+
+void write(
+    const Type type,
+    const Metadata& metadata,
+    const Endpoints& endpoints,
+    const std::string filename,
+    BlockPointTable& table,
+    const Bounds& bounds)
+{
+    ensurePut(
+        endpoints.data,
+        filename + getExtension(type),
+        encode(type, metadata, endpoints, filename, table, bounds));
+}
+
 } // namespace io
 } // namespace entwine
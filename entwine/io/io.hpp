@@ -13,12 +13,14 @@
 #include <cstdint>
 #include <memory>
 #include <string>
+#include <vector>
 
 #include <entwine/types/endpoints.hpp>
 #include <entwine/types/vector-point-table.hpp>
 #include <entwine/util/json.hpp>
 
 #include <entwine/io/binary.hpp>
+#include <entwine/io/columnar.hpp>
 #include <entwine/io/laszip.hpp>
 #include <entwine/io/zstandard.hpp>
 
@@ -30,7 +32,7 @@ struct Metadata;
 namespace io
 {
 
-enum class Type { Binary, Laszip, Zstandard };
+enum class Type { Binary, Laszip, Zstandard, Columnar };
 
 Type toType(std::string s);
 std::string toString(Type t);
@@ -40,20 +42,55 @@ inline void from_json(const json& j, Type& t)
     t = toType(j.get<std::string>());
 }
 
+// The file extension, including the leading dot, of this data type.
+std::string getExtension(Type t);
+
+// The data type as named in ept.json.  Zstandard nodes which are shuffled or
+// compressed with a trained dictionary can't be decoded by EPT readers which
+// don't know about these extensions, so they are named with suffixes, like
+// "zstandard-shuffle", which such readers will reject rather than misread.
+struct EptDataType
+{
+    EptDataType() = default;
+    EptDataType(Type type, bool zstdShuffle, bool zstdDictionary)
+        : type(type)
+        , zstdShuffle(zstdShuffle)
+        , zstdDictionary(zstdDictionary)
+    { }
+
+    Type type = Type::Laszip;
+    bool zstdShuffle = false;
+    bool zstdDictionary = false;
+};
+
+EptDataType toEptDataType(std::string s);
+std::string toString(const EptDataType& t);
+
+// Encoding is CPU-bound while writing the result is IO-bound, so callers which
+// care about throughput may perform these steps separately.
 template <typename... Args>
-void write(Type type, Args&&... args)
+std::vector<char> encode(Type type, Args&&... args)
 {
     auto f = ([type]()
     {
-        if (type == Type::Binary) return binary::write;
-        if (type == Type::Laszip) return laszip::write;
-        if (type == Type::Zstandard) return zstandard::write;
+        if (type == Type::Binary) return binary::encode;
+        if (type == Type::Laszip) return laszip::encode;
+        if (type == Type::Zstandard) return zstandard::encode;
+        if (type == Type::Columnar) return columnar::encode;
         throw std::runtime_error("Invalid data type");
     })();
 
-    f(std::forward<Args>(args)...);
+    return f(std::forward<Args>(args)...);
 }
 
+void write(
+    Type type,
+    const Metadata& metadata,
+    const Endpoints& endpoints,
+    std::string filename,
+    BlockPointTable& table,
+    const Bounds& bounds);
+
 template <typename... Args>
 void read(Type type, Args&&... args)
 {
@@ -62,6 +99,7 @@ void read(Type type, Args&&... args)
         if (type == Type::Binary) return binary::read;
         if (type == Type::Laszip) return laszip::read;
         if (type == Type::Zstandard) return zstandard::read;
+        if (type == Type::Columnar) return columnar::read;
         throw std::runtime_error("Invalid data type");
     })();
 
@@ -16,6 +16,7 @@
 #include <pdal/io/LasWriter.hpp>
 
 #include <entwine/types/metadata.hpp>
+#include <entwine/types/record.hpp>
 #include <entwine/util/io.hpp>
 #include <entwine/util/pdal-mutex.hpp>
 
@@ -26,24 +27,50 @@ namespace io
 namespace laszip
 {
 
-void write(
+std::vector<char> encode(
     const Metadata& metadata,
     const Endpoints& endpoints,
     const std::string filename,
     BlockPointTable& table,
     const Bounds bounds)
 {
-    const arbiter::Endpoint& out(endpoints.data);
+    // The LAS writer only writes to the filesystem, so encode into our scratch
+    // space and hand back the result.
     const arbiter::Endpoint& tmp(endpoints.tmp);
-
-    const bool local(out.isLocal());
-    const std::string localDir(local ? out.prefixedRoot() : tmp.prefixedRoot());
     const std::string localFile(
-            (local ? filename : arbiter::crypto::encodeAsHex(filename)) +
-            ".laz");
+            arbiter::crypto::encodeAsHex(filename) + ".laz");
+
+    // The LAS writer applies its own scale and offset, so it needs absolute
+    // coordinates rather than records in scaled memory form.
+    const bool convert(isScaledInMemory(metadata));
+    auto absoluteLayout = toLayout(metadata.absoluteSchema);
+    BlockPointTable absolute(absoluteLayout);
+    std::vector<char> records;
+
+    if (convert)
+    {
+        const RecordConverter converter(
+                metadata.memorySchema,
+                metadata.absoluteSchema);
+        const uint64_t pointSize(absoluteLayout.pointSize());
+
+        records.resize(table.size() * pointSize);
+        absolute.reserve(table.size());
+        for (std::size_t i(0); i < table.size(); ++i)
+        {
+            char* pos(records.data() + i * pointSize);
+            converter.convert(table.getPoint(i), pos);
+            absolute.insert(pos);
+        }
+    }
+
+    pdal::BasePointTable& input(
+            convert
+                ? static_cast<pdal::BasePointTable&>(absolute)
+                : static_cast<pdal::BasePointTable&>(table));
 
     pdal::BufferReader reader;
-    auto view(std::make_shared<pdal::PointView>(table));
+    auto view(std::make_shared<pdal::PointView>(input));
     for (std::size_t i(0); i < table.size(); ++i) view->getOrAddPoint(i);
     reader.addView(view);
 
@@ -52,7 +79,7 @@ void write(
     const uint64_t colorMask(contains(metadata.schema, "Red") ? 2 : 0);
 
     pdal::Options options;
-    options.add("filename", localDir + localFile);
+    options.add("filename", tmp.fullPath(localFile));
     options.add("minor_version", 2);
     options.add("extra_dims", "all");
     options.add("software_id", "Entwine " + currentEntwineVersion().toString());
@@ -71,7 +98,7 @@ void write(
 
     if (metadata.srs) options.add("a_srs", metadata.srs->wkt());
 
-    std::unique_lock<std::mutex> lock(PdalMutex::get());
+    PdalLock lock(PdalMutex::get());
 
     pdal::Stage* prev(&reader);
 
@@ -91,17 +118,15 @@ void write(
     pdal::LasWriter writer;
     writer.setOptions(options);
     writer.setInput(*prev);
-    writer.prepare(table);
+    writer.prepare(input);
 
     lock.unlock();
 
-    writer.execute(table);
+    writer.execute(input);
 
-    if (!local)
-    {
-        ensurePut(out, filename + ".laz", tmp.getBinary(localFile));
-        arbiter::remove(tmp.prefixedRoot() + localFile);
-    }
+    std::vector<char> encoded(tmp.getBinary(localFile));
+    arbiter::remove(tmp.fullPath(localFile));
+    return encoded;
 }
 
 void read(
@@ -119,12 +144,41 @@ void read(
     pdal::LasReader reader;
     reader.setOptions(o);
 
+    if (!isScaledInMemory(metadata))
+    {
+        {
+            PdalGuard lock(PdalMutex::get());
+            reader.prepare(table);
+        }
+
+        reader.execute(table);
+        return;
+    }
+
+    // The LAS reader produces absolute coordinates, so read into an absolute
+    // table and convert each block into our scaled memory form.
+    const RecordConverter converter(
+            metadata.absoluteSchema,
+            metadata.memorySchema);
+
+    auto absoluteLayout = toLayout(metadata.absoluteSchema);
+    VectorPointTable absolute(absoluteLayout, table.capacity());
+    uint64_t np(0);
+    absolute.setProcess([&]()
+    {
+        for (auto it(absolute.begin()); it != absolute.end(); ++it)
+        {
+            converter.convert(it.data(), table.getPoint(np++));
+        }
+    });
+
     {
-        std::lock_guard<std::mutex> lock(PdalMutex::get());
-        reader.prepare(table);
+        PdalGuard lock(PdalMutex::get());
+        reader.prepare(absolute);
     }
 
-    reader.execute(table);
+    reader.execute(absolute);
+    table.clear(np);
 }
 
 } // namespace laszip
@@ -27,7 +27,7 @@ namespace io
 namespace laszip
 {
 
-void write(
+std::vector<char> encode(
     const Metadata& Metadata,
     const Endpoints& endpoints,
     std::string filename,
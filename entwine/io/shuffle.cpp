@@ -0,0 +1,169 @@
+/******************************************************************************
+* Copyright (c) 2020, Connor Manning (connor@hobu.co)
+*
+* Entwine -- Point cloud indexing
+*
+* Entwine is available under the terms of the LGPL2 license. See COPYING
+* for specific license text and more information.
+*
+******************************************************************************/
+
+#include <entwine/io/shuffle.hpp>
+
+#include <algorithm>
+#include <cstring>
+#include <numeric>
+
+namespace entwine
+{
+namespace io
+{
+namespace shuffle
+{
+
+namespace
+{
+
+bool isDelta(const Dimension& d)
+{
+    return
+        d.name == "X" || d.name == "Y" || d.name == "Z" ||
+        d.name == "GpsTime";
+}
+
+// Deltas are taken over the raw bits of each value as an unsigned integer, so
+// they are lossless for any type, including doubles.
+template <typename T>
+void delta(char* data, const uint64_t np, const bool forward)
+{
+    T prev(0);
+    for (uint64_t i(0); i < np; ++i)
+    {
+        char* pos(data + i * sizeof(T));
+        T v;
+        std::memcpy(&v, pos, sizeof(T));
+
+        const T result(forward ? T(v - prev) : T(v + prev));
+        std::memcpy(pos, &result, sizeof(T));
+        prev = forward ? v : result;
+    }
+}
+
+void delta(
+    char* data,
+    const uint64_t np,
+    const uint64_t bytes,
+    const bool forward)
+{
+    switch (bytes)
+    {
+        case 1: return delta<uint8_t>(data, np, forward);
+        case 2: return delta<uint16_t>(data, np, forward);
+        case 4: return delta<uint32_t>(data, np, forward);
+        case 8: return delta<uint64_t>(data, np, forward);
+        default: return;
+    }
+}
+
+std::vector<uint64_t> getOrder(
+    const Schema& schema,
+    const std::vector<char>& rows,
+    const uint64_t np)
+{
+    std::vector<uint64_t> order(np);
+    std::iota(order.begin(), order.end(), 0);
+
+    const Dimension* time(maybeFind(schema, "GpsTime"));
+    if (!time || time->type != Type::Double) return order;
+
+    const uint64_t pointSize(getPointSize(schema));
+    const uint64_t offset(getOffset(schema, "GpsTime"));
+    std::vector<double> times(np);
+    for (uint64_t i(0); i < np; ++i)
+    {
+        std::memcpy(&times[i], rows.data() + i * pointSize + offset, 8);
+    }
+
+    std::stable_sort(
+        order.begin(),
+        order.end(),
+        [&times](uint64_t a, uint64_t b) { return times[a] < times[b]; });
+    return order;
+}
+
+} // unnamed namespace
+
+std::vector<char> encode(const Schema& schema, const std::vector<char>& rows)
+{
+    const uint64_t pointSize(getPointSize(schema));
+    const uint64_t np(rows.size() / pointSize);
+    const std::vector<uint64_t> order(getOrder(schema, rows, np));
+
+    std::vector<char> out(rows.size());
+    char* pos(out.data());
+
+    std::vector<char> column;
+    uint64_t offset(0);
+    for (const Dimension& d : schema)
+    {
+        const uint64_t bytes(size(d.type));
+        column.resize(np * bytes);
+
+        for (uint64_t i(0); i < np; ++i)
+        {
+            std::memcpy(
+                column.data() + i * bytes,
+                rows.data() + order[i] * pointSize + offset,
+                bytes);
+        }
+
+        if (isDelta(d)) delta(column.data(), np, bytes, true);
+
+        for (uint64_t b(0); b < bytes; ++b)
+        {
+            for (uint64_t i(0); i < np; ++i) *pos++ = column[i * bytes + b];
+        }
+
+        offset += bytes;
+    }
+
+    return out;
+}
+
+void decode(
+    const Schema& schema,
+    const char* src,
+    char* dst,
+    const uint64_t np)
+{
+    const uint64_t pointSize(getPointSize(schema));
+
+    std::vector<char> column;
+    uint64_t offset(0);
+    for (const Dimension& d : schema)
+    {
+        const uint64_t bytes(size(d.type));
+        column.resize(np * bytes);
+
+        for (uint64_t b(0); b < bytes; ++b)
+        {
+            for (uint64_t i(0); i < np; ++i) column[i * bytes + b] = *src++;
+        }
+
+        if (isDelta(d)) delta(column.data(), np, bytes, false);
+
+        for (uint64_t i(0); i < np; ++i)
+        {
+            std::memcpy(
+                dst + i * pointSize + offset,
+                column.data() + i * bytes,
+                bytes);
+        }
+
+        offset += bytes;
+    }
+}
+
+} // namespace shuffle
+} // namespace io
+} // namespace entwine
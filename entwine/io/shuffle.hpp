@@ -0,0 +1,39 @@
+/******************************************************************************
+* Copyright (c) 2020, Connor Manning (connor@hobu.co)
+*
+* Entwine -- Point cloud indexing
+*
+* Entwine is available under the terms of the LGPL2 license. See COPYING
+* for specific license text and more information.
+*
+******************************************************************************/
+
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+#include <entwine/types/dimension.hpp>
+
+namespace entwine
+{
+namespace io
+{
+namespace shuffle
+{
+
+// A reversible transform of packed point records, laid out by a schema, which
+// makes them far more compressible.  Points are sorted by GpsTime, if it
+// exists, and each dimension is then written as a column whose values are
+// split into byte planes - so the slowly varying high bytes of neighboring
+// values are adjacent.  XYZ and GpsTime are delta coded beforehand.
+//
+// The point order is not restored by decoding.
+std::vector<char> encode(const Schema& schema, const std::vector<char>& rows);
+
+// Reverse the transform of np points from src into packed records at dst.
+void decode(const Schema& schema, const char* src, char* dst, uint64_t np);
+
+} // namespace shuffle
+} // namespace io
+} // namespace entwine
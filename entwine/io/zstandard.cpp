@@ -10,10 +10,13 @@
 
 #include <entwine/io/zstandard.hpp>
 
-#include <pdal/compression/ZstdCompression.hpp>
-#include <pdal/filters/SortFilter.hpp>
-
+#include <entwine/builder/heuristics.hpp>
+#include <entwine/io/shuffle.hpp>
+#include <entwine/types/metadata.hpp>
+#include <entwine/types/record.hpp>
 #include <entwine/util/io.hpp>
+#include <entwine/util/unique.hpp>
+#include <entwine/util/zstd.hpp>
 
 namespace entwine
 {
@@ -22,25 +25,86 @@ namespace io
 namespace zstandard
 {
 
-void write(
+namespace
+{
+
+// Nodes smaller than this are compressed on the calling thread regardless of
+// the configured worker count, since zstd splits a frame into jobs of about
+// this size and the workers would have nothing to share.
+const uint64_t threadedBytes(4 << 20);
+
+} // unnamed namespace
+
+const zstd::Dictionary* DictionaryCache::get(
+    const Metadata& m,
+    const Endpoints& endpoints)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    if (!m_loaded)
+    {
+        if (endpoints.output.tryGetSize(dictionaryFilename))
+        {
+            m_dictionary = makeUnique<zstd::Dictionary>(
+                ensureGetBinary(endpoints.output, dictionaryFilename),
+                m.internal.zstdOptions.level);
+        }
+        m_loaded = true;
+    }
+    return m_dictionary.get();
+}
+
+void DictionaryCache::train(
+    const Metadata& m,
+    const Endpoints& endpoints,
+    const std::vector<char>& samples,
+    const std::vector<std::size_t>& sizes)
+{
+    std::vector<char> data(
+        zstd::Dictionary::train(samples, sizes, heuristics::dictionarySize));
+
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_loaded = true;
+    if (data.empty()) return;
+
+    ensurePut(endpoints.output, dictionaryFilename, data);
+    m_dictionary = makeUnique<zstd::Dictionary>(
+        std::move(data),
+        m.internal.zstdOptions.level);
+}
+
+std::vector<char> encode(
     const Metadata& metadata,
     const Endpoints& endpoints,
     const std::string filename,
     BlockPointTable& table,
     const Bounds bounds)
 {
-    const std::vector<char> uncompressed = binary::pack(metadata, table);
+    const uint64_t size(table.size() * metadata.toStored->toPointSize());
 
-    std::vector<char> compressed;
-    pdal::ZstdCompressor compressor([&compressed](char* pos, std::size_t size)
+    zstd::Options options(metadata.internal.zstdOptions);
+    if (size < threadedBytes) options.threads = 0;
+    if (metadata.dictionary)
     {
-        compressed.insert(compressed.end(), pos, pos + size);
-    }, 3); // ZSTD_CLEVEL_DEFAULT = 3.
+        options.dictionary = metadata.dictionary->get(metadata, endpoints);
+    }
 
-    compressor.compress(uncompressed.data(), uncompressed.size());
-    compressor.done();
+    zstd::Compressor compressor(options, size);
+    if (metadata.zstdShuffle)
+    {
+        // Shuffling works by column, so it needs the whole node packed.
+        const std::vector<char> shuffled(
+            shuffle::encode(metadata.schema, binary::pack(metadata, table)));
+        compressor.add(shuffled.data(), shuffled.size());
+        return compressor.done();
+    }
 
-    ensurePut(endpoints.data, filename + ".zst", compressed);
+    // Otherwise feed records to the compressor as they are packed, rather
+    // than packing the whole node up front.
+    binary::pack(metadata, table, [&compressor](const char* pos, std::size_t n)
+    {
+        compressor.add(pos, n);
+    });
+    return compressor.done();
 }
 
 void read(
@@ -53,15 +117,59 @@ void read(
         endpoints.data,
         filename + ".zst");
 
-    std::vector<char> uncompressed;
-    pdal::ZstdDecompressor dec([&uncompressed](char* pos, std::size_t size)
+    // Our table is sized by the hierarchy point count for this node, so we
+    // know the decompressed size exactly.
+    const RecordConverter& converter(*metadata.fromStored);
+    const uint64_t np(table.capacity());
+    const uint64_t size(np * converter.fromPointSize());
+
+    const zstd::Dictionary* dictionary(
+        metadata.dictionary
+            ? metadata.dictionary->get(metadata, endpoints)
+            : nullptr);
+
+    if (metadata.zstdShuffle)
     {
-        uncompressed.insert(uncompressed.end(), pos, pos + size);
-    });
+        const std::vector<char> shuffled(
+            zstd::decompress(compressed, size, dictionary));
 
-    dec.decompress(compressed.data(), compressed.size());
+        // If the stored records are our in-memory records, unshuffle straight
+        // into the table.
+        if (converter.identity())
+        {
+            shuffle::decode(
+                metadata.schema,
+                shuffled.data(),
+                table.data().data(),
+                np);
+            table.clear(np);
+            return;
+        }
+
+        std::vector<char> rows(size);
+        shuffle::decode(metadata.schema, shuffled.data(), rows.data(), np);
+        binary::unpack(metadata, table, std::move(rows));
+        return;
+    }
+
+    // If the stored records are our in-memory records, decompress straight
+    // into the table.
+    if (converter.identity())
+    {
+        zstd::decompress(
+            compressed.data(),
+            compressed.size(),
+            table.data().data(),
+            size,
+            dictionary);
+        table.clear(np);
+        return;
+    }
 
-    binary::unpack(metadata, table, std::move(uncompressed));
+    binary::unpack(
+        metadata,
+        table,
+        zstd::decompress(compressed, size, dictionary));
 }
 
 } // namespace zstandard
@@ -8,7 +8,13 @@
 *
 ******************************************************************************/
 
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
 #include <entwine/io/binary.hpp>
+#include <entwine/util/zstd.hpp>
 
 namespace entwine
 {
@@ -17,7 +23,34 @@ namespace io
 namespace zstandard
 {
 
-void write(
+// The name, at the output root, of a dataset's trained dictionary.
+const std::string dictionaryFilename("ept-zstd.dict");
+
+// Holds the dictionary shared by every node of a dataset built with one.  It
+// is trained once from a sample of a new build's nodes, or loaded from the
+// output on first use by a continued build.
+class DictionaryCache
+{
+public:
+    // The dictionary to compress with, or null if none has been trained.
+    const zstd::Dictionary* get(const Metadata& m, const Endpoints& endpoints);
+
+    // Train a dictionary from concatenated samples of stored node data, and
+    // write it to the output.  If the samples are insufficient, nodes will be
+    // compressed without one.
+    void train(
+        const Metadata& m,
+        const Endpoints& endpoints,
+        const std::vector<char>& samples,
+        const std::vector<std::size_t>& sizes);
+
+private:
+    std::mutex m_mutex;
+    bool m_loaded = false;
+    std::unique_ptr<zstd::Dictionary> m_dictionary;
+};
+
+std::vector<char> encode(
     const Metadata& Metadata,
     const Endpoints& endpoints,
     const std::string filename,
@@ -13,8 +13,10 @@
 #include <cstdint>
 
 #include <entwine/builder/heuristics.hpp>
+#include <entwine/builder/schedule.hpp>
 #include <entwine/types/defs.hpp>
 #include <entwine/util/json.hpp>
+#include <entwine/util/zstd.hpp>
 
 namespace entwine
 {
@@ -27,15 +29,27 @@ struct BuildParameters
         uint64_t maxNodeSize,
         uint64_t cacheSize,
         uint64_t sleepCount,
+        uint64_t maxMemory,
+        Schedule schedule,
+        bool hugePages,
         uint64_t progressInterval,
         uint64_t hierarchyStep,
+        uint64_t uploadThreads,
+        uint64_t uploadQueueSize,
+        zstd::Options zstdOptions,
         bool verbose = true)
         : minNodeSize(minNodeSize)
         , maxNodeSize(maxNodeSize)
         , cacheSize(cacheSize)
         , sleepCount(sleepCount)
+        , maxMemory(maxMemory)
+        , schedule(schedule)
+        , hugePages(hugePages)
         , progressInterval(progressInterval)
         , hierarchyStep(hierarchyStep)
+        , uploadThreads(uploadThreads)
+        , uploadQueueSize(uploadQueueSize)
+        , zstdOptions(zstdOptions)
         , verbose(verbose)
     { }
     BuildParameters(uint64_t minNodeSize, uint64_t maxNodeSize)
@@ -48,8 +62,14 @@ struct BuildParameters
 
     uint64_t cacheSize = heuristics::cacheSize;
     uint64_t sleepCount = heuristics::sleepCount;
+    uint64_t maxMemory = 0; // In bytes, with zero meaning no byte budget.
+    Schedule schedule = Schedule::Manifest;
+    bool hugePages = false;
     uint64_t progressInterval = 10;
     uint64_t hierarchyStep = 0;
+    uint64_t uploadThreads = heuristics::uploadThreads;
+    uint64_t uploadQueueSize = heuristics::uploadQueueSize;
+    zstd::Options zstdOptions; // For the zstandard data type.
     bool verbose = true;
 };
 
@@ -59,7 +79,10 @@ inline void to_json(json& j, const BuildParameters& p)
         { "software", "Entwine" },
         { "version", currentEntwineVersion() },
         { "minNodeSize", p.minNodeSize },
-        { "maxNodeSize", p.maxNodeSize }
+        { "maxNodeSize", p.maxNodeSize },
+        { "zstdLevel", p.zstdOptions.level },
+        { "zstdLong", p.zstdOptions.longDistance },
+        { "zstdThreads", p.zstdOptions.threads }
     };
     if (p.hierarchyStep) j.update({ { "hierarchyStep", p.hierarchyStep } });
 }
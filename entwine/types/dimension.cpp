@@ -151,6 +151,16 @@ Dimension& find(Schema& dims, std::string name)
 {
     return const_cast<Dimension&>(find(static_cast<const Schema&>(dims), name));
 }
+uint64_t getOffset(const Schema& dims, const std::string name)
+{
+    uint64_t offset(0);
+    for (const Dimension& d : dims)
+    {
+        if (d.name == name) return offset;
+        offset += size(d.type);
+    }
+    throw std::runtime_error("Failed to find dimension: " + name);
+}
 bool contains(const Schema& dims, const std::string name)
 {
     return static_cast<bool>(maybeFind(dims, name));
@@ -212,6 +222,17 @@ Schema makeAbsolute(Schema list)
     return list;
 }
 
+Schema makeInMemory(Schema list)
+{
+    const bool scaled(
+        getScaleOffset(list) &&
+        find(list, "X").type == DimType::Signed32 &&
+        find(list, "Y").type == DimType::Signed32 &&
+        find(list, "Z").type == DimType::Signed32);
+
+    return scaled ? list : makeAbsolute(list);
+}
+
 Schema combine(Schema agg, const Schema& cur, const bool fixed)
 {
     for (const auto& incoming : cur)
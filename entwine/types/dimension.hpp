@@ -68,6 +68,7 @@ const Dimension* maybeFind(const Schema& dims, std::string name);
 const Dimension& find(const Schema& dims, std::string name);
 Dimension* maybeFind(Schema& dims, std::string name);
 Dimension& find(Schema& dims, std::string name);
+uint64_t getOffset(const Schema& dims, std::string name);
 bool contains(const Schema& dims, std::string name);
 Schema omit(Schema dims, std::string name);
 Schema omit(Schema dims, const StringList& names);
@@ -78,6 +79,11 @@ Dimension combine(Dimension agg, const Dimension& dim);
 Schema combine(Schema agg, const Schema& list, bool fixed = false);
 
 Schema makeAbsolute(Schema list);
+
+// The schema of points held in memory while building.  With a scale and
+// offset, XYZ are kept as the scaled integers in which they are stored, and
+// otherwise as absolute doubles.
+Schema makeInMemory(Schema list);
 Schema fromLayout(const pdal::PointLayout& layout);
 FixedPointLayout toLayout(const Schema& list);
 
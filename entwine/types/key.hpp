@@ -10,16 +10,21 @@
 
 #pragma once
 
+#include <algorithm>
 #include <cassert>
 #include <cctype>
+#include <cmath>
+#include <cstddef>
 #include <cstdint>
 #include <ostream>
 #include <string>
 
+#include <pdal/util/Utils.hpp>
+
 #include <entwine/types/bounds.hpp>
 #include <entwine/types/dir.hpp>
-#include <entwine/types/metadata.hpp>
 #include <entwine/types/point.hpp>
+#include <entwine/util/json.hpp>
 
 namespace entwine
 {
@@ -146,95 +151,238 @@ inline bool operator!=(const Dxyz& a, const Dxyz& b)
     return !(a == b);
 }
 
-struct Key
+// The direction of a position from its parent, one depth shallower.
+inline Dir getDirection(const Xyz& p)
 {
-    Key(Bounds cube, uint64_t startDepth)
-        : cube(cube)
-        , startDepth(startDepth)
-        , b(cube)
+    return static_cast<Dir>(
+            (p.y & 1 ? NsBit : 0) |
+            (p.x & 1 ? EwBit : 0) |
+            (p.z & 1 ? UdBit : 0));
+}
+
+// Maps points within a cube onto a fixed-resolution integer lattice.  The
+// position of a point at any depth is then a shift of its lattice coordinates
+// rather than a bisection of floating point bounds per depth.
+class Quantizer
+{
+public:
+    // Past the precision of a double, bisection can't separate points anyway.
+    static constexpr uint64_t bits = 52;
+
+    Quantizer() = default;
+    explicit Quantizer(const Bounds& cube)
+        : m_min(cube.min())
+        , m_size(cube.max() - cube.min())
+        , m_scale(scale(m_size.x), scale(m_size.y), scale(m_size.z))
+        , m_cell(cellSize(bits))
+    { }
+
+    // Points outside of the cube, including NaN, are clamped onto its edges.
+    Xyz quantize(const Point& p) const
+    {
+        return Xyz(
+                fit(p.x, m_min.x, m_scale.x, m_cell.x),
+                fit(p.y, m_min.y, m_scale.y, m_cell.y),
+                fit(p.z, m_min.z, m_scale.z, m_cell.z));
+    }
+
+    // Kept as a flat loop over contiguous coordinates so it may be vectorized.
+    void quantize(
+            const double* x,
+            const double* y,
+            const double* z,
+            std::size_t n,
+            Xyz* out) const
+    {
+        for (std::size_t i(0); i < n; ++i)
+        {
+            out[i].x = fit(x[i], m_min.x, m_scale.x, m_cell.x);
+            out[i].y = fit(y[i], m_min.y, m_scale.y, m_cell.y);
+            out[i].z = fit(z[i], m_min.z, m_scale.z, m_cell.z);
+        }
+    }
+
+    static Xyz position(const Xyz& lattice, uint64_t depth)
+    {
+        if (depth <= bits)
+        {
+            const uint64_t shift(bits - depth);
+            return Xyz(
+                    lattice.x >> shift,
+                    lattice.y >> shift,
+                    lattice.z >> shift);
+        }
+
+        const uint64_t shift(depth - bits);
+        return Xyz(
+                lattice.x << shift,
+                lattice.y << shift,
+                lattice.z << shift);
+    }
+
+    // Cell edges are computed the same way at every depth, so the edge shared
+    // by neighboring cells, and by a cell and its children, is identical.
+    Bounds bounds(const Xyz& p, uint64_t depth) const
+    {
+        const Point size(cellSize(depth));
+        return Bounds(
+                edge(p.x, m_min.x, size.x),
+                edge(p.y, m_min.y, size.y),
+                edge(p.z, m_min.z, size.z),
+                edge(p.x + 1, m_min.x, size.x),
+                edge(p.y + 1, m_min.y, size.y),
+                edge(p.z + 1, m_min.z, size.z));
+    }
+
+    Point mid(const Xyz& p, uint64_t depth) const
+    {
+        const Point size(cellSize(depth));
+        return Point(
+                m_min.x + (p.x + 0.5) * size.x,
+                m_min.y + (p.y + 0.5) * size.y,
+                m_min.z + (p.z + 0.5) * size.z);
+    }
+
+private:
+    static constexpr double cells()
+    {
+        return static_cast<double>(uint64_t(1) << bits);
+    }
+
+    static double scale(double extent)
+    {
+        return extent > 0 ? cells() / extent : 0;
+    }
+
+    static constexpr uint64_t last() { return (uint64_t(1) << bits) - 1; }
+
+    // Written so that NaN clamps to zero rather than reaching the cast.
+    static uint64_t cell(double v)
     {
-        reset();
+        if (!(v > 0)) return 0;
+        if (v >= static_cast<double>(last())) return last();
+        return static_cast<uint64_t>(v);
     }
 
+    static double edge(uint64_t c, double min, double size)
+    {
+        return min + static_cast<double>(c) * size;
+    }
+
+    // Rounding in the scaled coordinate may land a point just beside the cell
+    // whose bounds contain it, so nudge it into that cell.  Cell edges at
+    // every shallower depth are a subset of these, so the point then lies
+    // within the bounds of its position at any depth.
+    static uint64_t fit(double v, double min, double scale, double size)
+    {
+        uint64_t c(cell((v - min) * scale));
+        if (!(size > 0)) return c;
+
+        while (c > 0 && v < edge(c, min, size)) --c;
+        while (c < last() && v >= edge(c + 1, min, size)) ++c;
+        return c;
+    }
+
+    Point cellSize(uint64_t depth) const
+    {
+        const int e(-static_cast<int>(depth));
+        return Point(
+                std::ldexp(m_size.x, e),
+                std::ldexp(m_size.y, e),
+                std::ldexp(m_size.z, e));
+    }
+
+    Point m_min;
+    Point m_size;
+    Point m_scale;
+    Point m_cell;
+};
+
+// The position of a point at a given depth, including the chunk-local depths
+// below the start depth.  A point is quantized once, after which stepping to
+// a deeper position is a shift.
+struct Key
+{
+    Key(const Quantizer& quantizer, uint64_t startDepth)
+        : q(&quantizer)
+        , startDepth(startDepth)
+    { }
+
     void reset()
     {
-        b = cube;
-        p.reset();
+        l.reset();
+        d = 0;
     }
 
     void init(const Point& g) { init(g, 0); }
+    void init(const Point& g, uint64_t depth) { init(q->quantize(g), depth); }
 
-    void init(const Point& g, uint64_t depth)
+    void init(const Xyz& lattice) { init(lattice, 0); }
+    void init(const Xyz& lattice, uint64_t depth)
     {
-        reset();
-        for (std::size_t d(0); d < startDepth + depth; ++d) step(g);
+        l = lattice;
+        d = startDepth + depth;
     }
 
-    Dir step(const Point& g)
+    Dir step()
     {
-        return step(getDirection(b.mid(), g));
+        ++d;
+        return getDirection(position());
     }
 
-    Dir step(Dir dir)
+    // The direction of this point from the node containing it at the given
+    // absolute depth.
+    Dir dirAt(uint64_t depth) const
     {
-        p.x = (p.x << 1) | (isEast(dir)  ? 1u : 0u);
-        p.y = (p.y << 1) | (isNorth(dir) ? 1u : 0u);
-        p.z = (p.z << 1) | (isUp(dir)    ? 1u : 0u);
-
-        b.go(dir);
-        return dir;
+        return getDirection(Quantizer::position(l, depth + 1));
     }
 
-    const Bounds& bounds() const { return b; }
-    const Xyz& position() const { return p; }
+    Xyz position() const { return Quantizer::position(l, d); }
+    Bounds bounds() const { return q->bounds(position(), d); }
+    Point mid() const { return q->mid(position(), d); }
+    uint64_t depth() const { return d; }
 
-    const Bounds cube;
-    const uint64_t startDepth = 0;
+    const Quantizer* q = nullptr;
+    uint64_t startDepth = 0;
 
-    Bounds b;
-    Xyz p;
+    Xyz l;
+    uint64_t d = 0;
 };
 
 inline bool operator<(const Key& a, const Key& b)
 {
-    return a.p < b.p;
+    return a.position() < b.position();
 }
 
 inline bool operator==(const Key& a, const Key& b)
 {
-    return a.p == b.p;
+    return a.position() == b.position();
 }
 
 struct ChunkKey
 {
-    ChunkKey(Bounds cube, uint64_t startDepth)
-        : k(cube, startDepth)
-    {
-        reset();
-    }
+    explicit ChunkKey(const Quantizer& quantizer) : q(&quantizer) { }
 
     void reset()
     {
         d = 0;
-        k.reset();
-    }
-
-    void init(const Point& g, uint64_t d)
-    {
-        reset();
-        while (depth() < d) step(g);
+        p.reset();
     }
 
-    Dir step(const Point& g)
+    void init(const Point& g, uint64_t depth) { init(q->quantize(g), depth); }
+    void init(const Xyz& lattice, uint64_t depth)
     {
-        ++d;
-        return k.step(g);
+        d = depth;
+        p = Quantizer::position(lattice, d);
     }
 
     Dir step(Dir dir)
     {
         ++d;
-        return k.step(dir);
+        p.x = (p.x << 1) | (isEast(dir)  ? 1u : 0u);
+        p.y = (p.y << 1) | (isNorth(dir) ? 1u : 0u);
+        p.z = (p.z << 1) | (isUp(dir)    ? 1u : 0u);
+        return dir;
     }
 
     ChunkKey getStep(Dir dir) const
@@ -246,16 +394,16 @@ struct ChunkKey
 
     std::string toString() const { return position().toString(d); }
 
-    Dxyz get() const { return Dxyz(d, k.p); }
+    Dxyz get() const { return Dxyz(d, p); }
     Dxyz dxyz() const { return get(); }
 
-    const Xyz& position() const { return k.position(); }
-    const Bounds& bounds() const { return k.bounds(); }
-    const Key& key() const { return k; }
+    const Xyz& position() const { return p; }
+    Bounds bounds() const { return q->bounds(p, d); }
     uint64_t depth() const { return d; }
 
-    Key k;
+    const Quantizer* q = nullptr;
     uint64_t d = 0;
+    Xyz p;
 };
 
 inline std::ostream& operator<<(std::ostream& os, const Xyz& xyz)
@@ -278,10 +426,11 @@ namespace std
     {
         std::size_t operator()(const entwine::Key& k) const
         {
+            const entwine::Xyz p(k.position());
             return
-                std::hash<uint64_t>()(k.p.x) ^
-                std::hash<uint64_t>()(k.p.y) ^
-                std::hash<uint64_t>()(k.p.z);
+                std::hash<uint64_t>()(p.x) ^
+                std::hash<uint64_t>()(p.y) ^
+                std::hash<uint64_t>()(p.z);
         }
     };
 }
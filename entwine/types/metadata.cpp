@@ -33,8 +33,12 @@ Metadata::Metadata(
     : eptVersion(eptVersion)
     , schema(schema)
     , absoluteSchema(makeAbsolute(schema))
+    , memorySchema(makeInMemory(schema))
+    , toStored(std::make_shared<RecordConverter>(memorySchema, schema))
+    , fromStored(std::make_shared<RecordConverter>(schema, memorySchema))
     , boundsConforming(boundsConforming)
     , bounds(bounds)
+    , quantizer(bounds)
     , srs(srs)
     , subset(subset)
     , dataType(dataType)
@@ -59,14 +63,33 @@ void to_json(json& j, const Metadata& m)
         { "boundsConforming", m.boundsConforming },
         { "schema", m.schema },
         { "span", m.span },
-        { "dataType", m.dataType },
+        { "dataType", getEptDataType(m) },
         { "hierarchyType", "json" }
     };
 
+    // These are implied by the data type, but are always recorded for
+    // zstandard data so that a continued build can't change them by
+    // configuration.
+    if (m.dataType == io::Type::Zstandard)
+    {
+        j.update({
+            { "zstdDictionary", static_cast<bool>(m.dictionary) },
+            { "zstdShuffle", m.zstdShuffle }
+        });
+    }
     if (m.srs) j.update({ { "srs", *m.srs } });
     if (m.subset) j.update({ { "subset", *m.subset } });
 }
 
+std::string getEptDataType(const Metadata& m)
+{
+    return io::toString(
+        io::EptDataType(
+            m.dataType,
+            m.zstdShuffle,
+            static_cast<bool>(m.dictionary)));
+}
+
 Bounds cubeify(Bounds b)
 {
     double diam(std::max(std::max(b.width(), b.depth()), b.height()));
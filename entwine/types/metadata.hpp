@@ -19,6 +19,8 @@
 #include <entwine/types/build-parameters.hpp>
 #include <entwine/types/defs.hpp>
 #include <entwine/types/dimension.hpp>
+#include <entwine/types/key.hpp>
+#include <entwine/types/record.hpp>
 #include <entwine/types/srs.hpp>
 #include <entwine/types/subset.hpp>
 #include <entwine/types/version.hpp>
@@ -44,13 +46,27 @@ struct Metadata
 
     Schema schema;
     Schema absoluteSchema;
+    Schema memorySchema;
+
+    // Compiled conversions between in-memory records and their stored form,
+    // shared by every chunk written or loaded under this metadata.
+    std::shared_ptr<const RecordConverter> toStored;
+    std::shared_ptr<const RecordConverter> fromStored;
+
     Bounds boundsConforming;
     Bounds bounds;
+    Quantizer quantizer;
 
     optional<Srs> srs;
     optional<Subset> subset;
 
     io::Type dataType = io::Type::Laszip;
+
+    // Set if nodes of the zstandard data type use a trained dictionary.
+    std::shared_ptr<io::zstandard::DictionaryCache> dictionary;
+
+    // Whether zstandard nodes are shuffled before compression.
+    bool zstdShuffle = false;
     uint64_t span = 0;
 
     BuildParameters internal;
@@ -58,6 +74,9 @@ struct Metadata
 
 void to_json(json& j, const Metadata& m);
 
+// The data type as named in ept.json - see io::EptDataType.
+std::string getEptDataType(const Metadata& m);
+
 Bounds cubeify(Bounds bounds);
 
 inline uint64_t getStartDepth(const Metadata& m)
@@ -69,6 +88,12 @@ inline uint64_t getSharedDepth(const Metadata& m)
     return m.subset ? getSplits(*m.subset) : 0;
 }
 
+// Whether points held in memory are laid out exactly as they are stored.
+inline bool isScaledInMemory(const Metadata& m)
+{
+    return find(m.memorySchema, "X").type != Type::Double;
+}
+
 inline std::string getPostfix(const Metadata& m)
 {
     return m.subset ? "-" + std::to_string(m.subset->id) : "";
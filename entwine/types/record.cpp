@@ -0,0 +1,106 @@
+/******************************************************************************
+* Copyright (c) 2020, Connor Manning (connor@hobu.co)
+*
+* Entwine -- Point cloud indexing
+*
+* Entwine is available under the terms of the LGPL2 license. See COPYING
+* for specific license text and more information.
+*
+******************************************************************************/
+
+#include <entwine/types/record.hpp>
+
+#include <stdexcept>
+
+#include <entwine/types/defs.hpp>
+
+namespace entwine
+{
+
+namespace
+{
+
+bool isXyz(const Dimension& d)
+{
+    return d.name == "X" || d.name == "Y" || d.name == "Z";
+}
+
+} // unnamed namespace
+
+RecordXyz::RecordXyz(const Schema& schema)
+    : m_offsets {
+        getOffset(schema, "X"),
+        getOffset(schema, "Y"),
+        getOffset(schema, "Z")
+    }
+{
+    const Dimension& x(find(schema, "X"));
+    const Dimension& y(find(schema, "Y"));
+    const Dimension& z(find(schema, "Z"));
+
+    for (const Dimension* d : { &x, &y, &z })
+    {
+        if (d->type != x.type)
+        {
+            throw std::runtime_error("XYZ must share a single type");
+        }
+    }
+
+    if (x.type == DimType::Signed32) m_scaled = true;
+    else if (x.type != DimType::Double)
+    {
+        throw std::runtime_error("Invalid XYZ type: " + typeString(x.type));
+    }
+
+    m_scale = Point(x.scale, y.scale, z.scale);
+    m_offset = Point(x.offset, y.offset, z.offset);
+}
+
+RecordConverter::RecordConverter(const Schema& from, const Schema& to)
+    : m_from(from)
+    , m_to(to)
+    , m_fromSize(getPointSize(from))
+    , m_toSize(getPointSize(to))
+    , m_xyz(!m_from.sameAs(m_to))
+{
+    if (from.size() != to.size())
+    {
+        throw std::runtime_error("Cannot convert between differing schemas");
+    }
+
+    uint64_t src(0);
+    uint64_t dst(0);
+    for (std::size_t i(0); i < from.size(); ++i)
+    {
+        const Dimension& a(from[i]);
+        const Dimension& b(to[i]);
+        if (a.name != b.name)
+        {
+            throw std::runtime_error("Mismatched dimension: " + a.name);
+        }
+
+        const uint64_t bytes(size(a.type));
+        if (!m_xyz || !isXyz(a))
+        {
+            if (a.type != b.type)
+            {
+                throw std::runtime_error("Mismatched type for " + a.name);
+            }
+
+            // Extend the previous run if it ended right where this starts.
+            if (
+                !m_runs.empty() &&
+                m_runs.back().src + m_runs.back().size == src &&
+                m_runs.back().dst + m_runs.back().size == dst)
+            {
+                m_runs.back().size += bytes;
+            }
+            else m_runs.push_back({ src, dst, bytes });
+        }
+
+        src += bytes;
+        dst += size(b.type);
+    }
+}
+
+} // namespace entwine
@@ -0,0 +1,176 @@
+/******************************************************************************
+* Copyright (c) 2020, Connor Manning (connor@hobu.co)
+*
+* Entwine -- Point cloud indexing
+*
+* Entwine is available under the terms of the LGPL2 license. See COPYING
+* for specific license text and more information.
+*
+******************************************************************************/
+
+#pragma once
+
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <limits>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include <entwine/types/dimension.hpp>
+#include <entwine/types/point.hpp>
+
+namespace entwine
+{
+
+// Reads and writes the XYZ coordinates of point records laid out by a schema,
+// in which they are either absolute doubles or scaled 32-bit integers.
+class RecordXyz
+{
+public:
+    explicit RecordXyz(const Schema& schema);
+
+    Point get(const char* record) const
+    {
+        if (!m_scaled)
+        {
+            return Point(
+                    read<double>(record, m_offsets[0]),
+                    read<double>(record, m_offsets[1]),
+                    read<double>(record, m_offsets[2]));
+        }
+
+        return Point(
+                read<int32_t>(record, m_offsets[0]) * m_scale.x + m_offset.x,
+                read<int32_t>(record, m_offsets[1]) * m_scale.y + m_offset.y,
+                read<int32_t>(record, m_offsets[2]) * m_scale.z + m_offset.z);
+    }
+
+    // Scaled values are rounded to the nearest integer.  Throws if a value
+    // does not fit in 32 bits at our scale and offset.
+    void set(char* record, const Point& p) const
+    {
+        if (!m_scaled)
+        {
+            write(record, m_offsets[0], p.x);
+            write(record, m_offsets[1], p.y);
+            write(record, m_offsets[2], p.z);
+            return;
+        }
+
+        write(record, m_offsets[0], scale(p.x, m_scale.x, m_offset.x));
+        write(record, m_offsets[1], scale(p.y, m_scale.y, m_offset.y));
+        write(record, m_offsets[2], scale(p.z, m_scale.z, m_offset.z));
+    }
+
+    bool scaled() const { return m_scaled; }
+
+    // True if XYZ are stored identically by both.
+    bool sameAs(const RecordXyz& other) const
+    {
+        return
+            m_scaled == other.m_scaled &&
+            (!m_scaled ||
+                (m_scale == other.m_scale && m_offset == other.m_offset));
+    }
+
+private:
+    template <typename T>
+    static T read(const char* record, uint64_t offset)
+    {
+        T v;
+        std::memcpy(&v, record + offset, sizeof(T));
+        return v;
+    }
+
+    template <typename T>
+    static void write(char* record, uint64_t offset, T v)
+    {
+        std::memcpy(record + offset, &v, sizeof(T));
+    }
+
+    static int32_t scale(double d, double scale, double offset)
+    {
+        const double v(std::round((d - offset) / scale));
+        if (
+            !(v >= std::numeric_limits<int32_t>::min() &&
+              v <= std::numeric_limits<int32_t>::max()))
+        {
+            throw std::runtime_error(
+                "Value out of range for its scale and offset: " +
+                std::to_string(d));
+        }
+        return static_cast<int32_t>(v);
+    }
+
+    bool m_scaled = false;
+    uint64_t m_offsets[3];
+    Point m_scale;
+    Point m_offset;
+};
+
+// Converts point records between two schemas holding the same dimensions,
+// which may differ in the types of XYZ.  The conversion is compiled once into
+// a list of contiguous byte runs, so records of identical layouts are copied
+// with a single memcpy.
+class RecordConverter
+{
+public:
+    RecordConverter(const Schema& from, const Schema& to);
+
+    void convert(const char* src, char* dst) const
+    {
+        for (const Run& run : m_runs)
+        {
+            std::memcpy(dst + run.dst, src + run.src, run.size);
+        }
+        if (m_xyz) m_to.set(dst, m_from.get(src));
+    }
+
+    // Converts contiguous arrays of np records.
+    void convert(const char* src, char* dst, uint64_t np) const
+    {
+        if (identity()) std::memcpy(dst, src, np * m_fromSize);
+        else
+        {
+            for (uint64_t i(0); i < np; ++i)
+            {
+                convert(src + i * m_fromSize, dst + i * m_toSize);
+            }
+        }
+    }
+
+    // True if records are laid out identically in both schemas.
+    bool identity() const
+    {
+        return
+            !m_xyz &&
+            m_fromSize == m_toSize &&
+            m_runs.size() == 1 &&
+            m_runs.front().size == m_fromSize;
+    }
+
+    uint64_t fromPointSize() const { return m_fromSize; }
+    uint64_t toPointSize() const { return m_toSize; }
+
+private:
+    // A contiguous range of dimensions shared verbatim by both schemas.
+    struct Run
+    {
+        uint64_t src = 0;
+        uint64_t dst = 0;
+        uint64_t size = 0;
+    };
+
+    RecordXyz m_from;
+    RecordXyz m_to;
+    uint64_t m_fromSize = 0;
+    uint64_t m_toSize = 0;
+
+    // Whether XYZ differ between the schemas, and must be converted.
+    bool m_xyz = true;
+    std::vector<Run> m_runs;
+};
+
+} // namespace entwine
@@ -17,14 +17,14 @@
 #include <pdal/PointRef.hpp>
 #include <pdal/PointTable.hpp>
 
+#include <entwine/util/slab-pool.hpp>
+
 namespace entwine
 {
 
 class MemBlock
 {
 public:
-    using Block = std::vector<char>;
-
     MemBlock(uint64_t pointSize, uint64_t pointsPerBlock)
         : m_pointSize(pointSize)
         , m_pointsPerBlock(pointsPerBlock)
@@ -34,12 +34,14 @@ public:
         m_refs.reserve(m_pointsPerBlock);
     }
 
+    ~MemBlock() { clear(); }
+
     char* next()
     {
         if (m_pos == m_end)
         {
-            m_blocks.emplace_back(Block(m_bytesPerBlock));
-            m_pos = m_blocks.back().data();
+            m_blocks.push_back(SlabPool::get().acquire(m_bytesPerBlock));
+            m_pos = m_blocks.back();
             m_end = m_pos + m_bytesPerBlock;
         }
 
@@ -50,9 +52,19 @@ public:
     }
 
     uint64_t size() const { return m_refs.size(); }
+    uint64_t bytes() const
+    {
+        return
+            m_blocks.size() * m_bytesPerBlock +
+            m_refs.capacity() * sizeof(char*);
+    }
     const std::vector<char*>& refs() const { return m_refs; }
     void clear()
     {
+        for (char* block : m_blocks)
+        {
+            SlabPool::get().release(block, m_bytesPerBlock);
+        }
         m_blocks.clear();
         m_pos = nullptr;
         m_end = nullptr;
@@ -60,11 +72,14 @@ public:
     }
 
 private:
+    MemBlock(const MemBlock&) = delete;
+    MemBlock& operator=(const MemBlock&) = delete;
+
     const uint64_t m_pointSize;
     const uint64_t m_pointsPerBlock;
     const uint64_t m_bytesPerBlock;
 
-    std::vector<Block> m_blocks;
+    std::vector<char*> m_blocks;
     char* m_pos = nullptr;
     char* m_end = nullptr;
 
@@ -80,6 +95,7 @@ public:
     { }
 
     void reserve(uint64_t size) { m_refs.reserve(size); }
+    void insert(char* point) { m_refs.push_back(point); }
     void insert(const MemBlock& m)
     {
         m_refs.insert(m_refs.end(), m.refs().begin(), m.refs().end());
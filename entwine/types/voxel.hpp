@@ -25,6 +25,7 @@ class Voxel
 public:
     const Point& point() const { return m_point; }
     const char* const data() const { return m_data; }
+    char* data() { return m_data; }
     void setData(char* pos) { m_data = pos; }
 
     void initDeep(const Point& point, const char* const pos, std::size_t size)
@@ -41,6 +42,12 @@ public:
         m_data = pos;
     }
 
+    void initShallow(const Point& point, char* pos)
+    {
+        m_point = point;
+        m_data = pos;
+    }
+
     void clip(const ScaleOffset& so)
     {
         m_point = entwine::clip(m_point, so);
@@ -35,8 +35,14 @@ BuildParameters getBuildParameters(const json& j)
         getMaxNodeSize(j),
         getCacheSize(j),
         getSleepCount(j),
+        getMaxMemory(j),
+        getSchedule(j),
+        getHugePages(j),
         getProgressInterval(j),
         getHierarchyStep(j),
+        getUploadThreads(j),
+        getUploadQueueSize(j),
+        getZstdOptions(j),
         getVerbose(j));
 }
 
@@ -56,7 +62,7 @@ Endpoints getEndpoints(const json& j)
 
 Metadata getMetadata(const json& j)
 {
-    return Metadata(
+    Metadata metadata(
         getEptVersion(j),
         getSchema(j),
         getBoundsConforming(j),
@@ -66,6 +72,35 @@ Metadata getMetadata(const json& j)
         getDataType(j),
         getSpan(j),
         getBuildParameters(j));
+
+    if (getZstdDictionary(j))
+    {
+        if (metadata.dataType != io::Type::Zstandard)
+        {
+            throw ConfigurationError(
+                "'zstdDictionary' requires the zstandard data type");
+        }
+
+        // Subsets are built independently and merged without re-encoding
+        // their nodes, so they cannot share a dictionary.
+        if (metadata.subset)
+        {
+            throw ConfigurationError(
+                "'zstdDictionary' cannot be used with subset builds");
+        }
+
+        metadata.dictionary =
+            std::make_shared<io::zstandard::DictionaryCache>();
+    }
+
+    metadata.zstdShuffle = getZstdShuffle(j);
+    if (metadata.zstdShuffle && metadata.dataType != io::Type::Zstandard)
+    {
+        throw ConfigurationError(
+            "'zstdShuffle' requires the zstandard data type");
+    }
+
+    return metadata;
 }
 
 arbiter::Arbiter getArbiter(const json& j)
@@ -88,7 +123,7 @@ std::string getTmp(const json& j)
 
 io::Type getDataType(const json& j)
 {
-    return j.value("dataType", io::Type::Laszip);
+    return io::toEptDataType(j.value("dataType", "laszip")).type;
 }
 
 // Bounds may be specified in one of two formats, depending on the context:
@@ -223,6 +258,7 @@ bool getDeep(const json& j) { return j.value("deep", false); }
 bool getStats(const json& j) { return j.value("stats", true); }
 bool getForce(const json& j) { return j.value("force", false); }
 bool getAbsolute(const json& j) { return j.value("absolute", false); }
+bool getHugePages(const json& j) { return j.value("hugePages", false); }
 
 uint64_t getSpan(const json& j)
 {
@@ -246,6 +282,16 @@ uint64_t getSleepCount(const json& j)
 {
     return j.value("sleepCount", heuristics::sleepCount);
 }
+uint64_t getMaxMemory(const json& j)
+{
+    // Specified in megabytes.
+    const uint64_t mb = j.value("maxMemory", 0);
+    return mb * 1024 * 1024;
+}
+Schedule getSchedule(const json& j)
+{
+    return j.value("schedule", Schedule::Manifest);
+}
 uint64_t getProgressInterval(const json& j)
 {
     return j.value("progressInterval", 10);
@@ -258,6 +304,31 @@ uint64_t getHierarchyStep(const json& j)
 {
     return j.value("hierarchyStep", 0);
 }
+uint64_t getUploadThreads(const json& j)
+{
+    return j.value("uploadThreads", heuristics::uploadThreads);
+}
+uint64_t getUploadQueueSize(const json& j)
+{
+    return j.value("uploadQueueSize", heuristics::uploadQueueSize);
+}
+bool getZstdDictionary(const json& j)
+{
+    return j.value("zstdDictionary", false) ||
+        io::toEptDataType(j.value("dataType", "laszip")).zstdDictionary;
+}
+bool getZstdShuffle(const json& j)
+{
+    return j.value("zstdShuffle", false) ||
+        io::toEptDataType(j.value("dataType", "laszip")).zstdShuffle;
+}
+zstd::Options getZstdOptions(const json& j)
+{
+    return zstd::Options(
+        j.value("zstdLevel", zstd::Options().level),
+        j.value("zstdLong", false),
+        j.value("zstdThreads", 0));
+}
 
 } // namespace config
 } // namespace entwine
@@ -32,6 +32,7 @@
 #include <entwine/util/json.hpp>
 #include <entwine/util/optional.hpp>
 #include <entwine/util/unique.hpp>
+#include <entwine/util/zstd.hpp>
 
 namespace entwine
 {
@@ -67,15 +68,23 @@ bool getDeep(const json& j);
 bool getStats(const json& j);
 bool getForce(const json& j);
 bool getAbsolute(const json& j);
+bool getHugePages(const json& j);
 
 uint64_t getSpan(const json& j);
 uint64_t getMinNodeSize(const json& j);
 uint64_t getMaxNodeSize(const json& j);
 uint64_t getCacheSize(const json& j);
 uint64_t getSleepCount(const json& j);
+uint64_t getMaxMemory(const json& j);
+Schedule getSchedule(const json& j);
 uint64_t getProgressInterval(const json& j);
 uint64_t getLimit(const json& j);
 uint64_t getHierarchyStep(const json& j);
+uint64_t getUploadThreads(const json& j);
+uint64_t getUploadQueueSize(const json& j);
+zstd::Options getZstdOptions(const json& j);
+bool getZstdDictionary(const json& j);
+bool getZstdShuffle(const json& j);
 
 } // namespace config
 } // namespace entwine
@@ -13,10 +13,11 @@
 #include <algorithm>
 #include <cassert>
 #include <iostream>
+#include <map>
+#include <mutex>
 #include <numeric>
 
 #include <pdal/io/BufferReader.hpp>
-#include <pdal/PipelineManager.hpp>
 #include <pdal/PointTable.hpp>
 
 #include <entwine/third/arbiter/arbiter.hpp>
@@ -25,6 +26,7 @@
 #include <entwine/util/io.hpp>
 #include <entwine/util/pdal-mutex.hpp>
 #include <entwine/util/pipeline.hpp>
+#include <entwine/util/pipeline-template.hpp>
 #include <entwine/util/pool.hpp>
 #include <entwine/util/unique.hpp>
 
@@ -34,7 +36,10 @@ namespace entwine
 void executeStandard(pdal::Stage& s, pdal::StreamPointTable& table)
 {
     pdal::PointTable standardTable;
-    s.prepare(standardTable);
+    {
+        PdalGuard lock(PdalMutex::get());
+        s.prepare(standardTable);
+    }
 
     pdal::PointRef pr(table);
     uint64_t current(0);
@@ -59,7 +64,7 @@ void executeStandard(pdal::Stage& s, pdal::StreamPointTable& table)
 void executeStreaming(pdal::Stage& s, pdal::StreamPointTable& table)
 {
     {
-        std::lock_guard<std::mutex> lock(PdalMutex::get());
+        PdalGuard lock(PdalMutex::get());
         s.prepare(table);
     }
     s.execute(table);
@@ -71,24 +76,60 @@ void execute(pdal::Stage& s, pdal::StreamPointTable& table)
     else executeStandard(s, table);
 }
 
-SourceInfo getShallowInfo(const json pipeline)
+namespace
 {
-    SourceInfo info;
-    info.pipeline = pipeline;
 
-    const json filterJson = slice(pipeline, 1);
+// Analysis of many files typically shares one pipeline, so parse and validate
+// each distinct pipeline only once.
+class TemplateCache
+{
+public:
+    std::shared_ptr<const PipelineTemplate> get(
+        const json& pipeline,
+        const std::string path)
+    {
+        const json t(toTemplate(pipeline, path));
+        const std::string key(t.dump());
+
+        std::lock_guard<std::mutex> lock(m_mutex);
+        auto& result(m_templates[key]);
+        if (!result) result = std::make_shared<const PipelineTemplate>(t);
+        return result;
+    }
+
+private:
+    std::mutex m_mutex;
+    std::map<std::string, std::shared_ptr<const PipelineTemplate>> m_templates;
+};
+
+json withStats(json pipeline)
+{
+    json& filter(findOrAppendStage(pipeline, "filters.stats"));
+    if (!filter.count("enumerate"))
+    {
+        filter.update({ { "enumerate", "Classification" } });
+    }
+    return pipeline;
+}
 
-    std::unique_lock<std::mutex> lock(PdalMutex::get());
+} // unnamed namespace
 
-    pdal::PipelineManager pm;
-    std::istringstream iss(pipeline.dump());
-    pm.readPipeline(iss);
-    pm.validateStageOptions();
+SourceInfo getShallowInfo(
+    const std::string path,
+    const json pipeline,
+    const PipelineTemplate& t)
+{
+    SourceInfo info;
+    info.pipeline = pipeline;
 
-    pdal::Stage& stage = getStage(pm);
+    auto chain = t.instantiate(path);
+    pdal::Stage& stage = chain->last();
     pdal::Reader& reader(getReader(stage));
-    const bool streamable = stage.pipelineStreamable();
-    if (!streamable) info.warnings.push_back("Pipeline is not streamable");
+    if (!t.streamable()) info.warnings.push_back("Pipeline is not streamable");
+
+    // Spatial reference handling within preview and prepare is not
+    // thread-safe, so these still require the global PDAL lock.
+    PdalLock lock(PdalMutex::get());
 
     const pdal::QuickInfo qi(reader.preview());
     if (!qi.valid()) throw ShallowInfoError("Failed to extract info");
@@ -117,7 +158,7 @@ SourceInfo getShallowInfo(const json pipeline)
     info.srs = readerSrs;
     info.bounds = native;
 
-    if (filterJson.empty()) return info;
+    if (t.pipeline().size() < 2) return info;
 
     // We've got most of what we need, except that our bounds and SRS may be
     // altered by a reprojection or other transformation.  So we'll flow the
@@ -135,17 +176,11 @@ SourceInfo getShallowInfo(const json pipeline)
     bufferReader.addView(view);
 
     {
-        lock.lock();
+        auto filters = t.instantiateFilters(bufferReader);
+        pdal::Stage& last = filters->last();
 
-        pdal::PipelineManager pm;
-        std::istringstream iss(filterJson.dump());
-        pm.readPipeline(iss);
-        pm.validateStageOptions();
-
-        pdal::Stage& last = getStage(pm);
-        getFirst(last).setInput(bufferReader);
+        lock.lock();
         last.prepare(table);
-
         lock.unlock();
 
         auto result = *last.execute(table).begin();
@@ -166,34 +201,24 @@ SourceInfo getShallowInfo(const json pipeline)
     return info;
 }
 
-SourceInfo getDeepInfo(json pipeline)
+SourceInfo getDeepInfo(
+    const std::string path,
+    const json pipeline,
+    const PipelineTemplate& t)
 {
     SourceInfo info;
     info.pipeline = pipeline;
 
-    {
-        json& filter(findOrAppendStage(pipeline, "filters.stats"));
-        if (!filter.count("enumerate"))
-        {
-            filter.update({ { "enumerate", "Classification" } });
-        }
-    }
-
     try
     {
-        std::unique_lock<std::mutex> lock(PdalMutex::get());
-        pdal::PipelineManager pm;
-        std::istringstream iss(pipeline.dump());
-        pm.readPipeline(iss);
-        pm.validateStageOptions();
-        if (!pm.pipelineStreamable())
+        auto chain = t.instantiate(path);
+        if (!t.streamable())
         {
             info.warnings.push_back("Pipeline is not streamable");
         }
-        lock.unlock();
 
         // Extract stats filter from the pipeline.
-        pdal::Stage& last(getStage(pm));
+        pdal::Stage& last(chain->last());
         if (last.getName() != "filters.stats")
         {
             throw std::runtime_error(
@@ -202,7 +227,7 @@ SourceInfo getDeepInfo(json pipeline)
         const pdal::StatsFilter& statsFilter(
             dynamic_cast<const pdal::StatsFilter&>(last));
 
-        pdal::Reader& reader(getReader(getStage(pm)));
+        pdal::Reader& reader(getReader(last));
 
         pdal::FixedPointTable table(4096);
         execute(last, table);
@@ -261,12 +286,26 @@ bool areStemsUnique(const SourceList& sources)
     return true;
 }
 
-SourceInfo analyzeOne(const std::string path, const bool deep, json pipeline)
+namespace
+{
+
+SourceInfo analyzeOne(
+    const std::string path,
+    const bool deep,
+    json pipeline,
+    TemplateCache& templates)
 {
     try
     {
         pipeline.at(0)["filename"] = path;
-        return deep ? getDeepInfo(pipeline) : getShallowInfo(pipeline);
+        if (deep)
+        {
+            const auto t(templates.get(withStats(pipeline), path));
+            return getDeepInfo(path, pipeline, *t);
+        }
+
+        const auto t(templates.get(pipeline, path));
+        return getShallowInfo(path, pipeline, *t);
     }
     catch (const std::exception& e)
     {
@@ -282,6 +321,14 @@ SourceInfo analyzeOne(const std::string path, const bool deep, json pipeline)
     }
 }
 
+} // unnamed namespace
+
+SourceInfo analyzeOne(const std::string path, const bool deep, json pipeline)
+{
+    TemplateCache templates;
+    return analyzeOne(path, deep, pipeline, templates);
+}
+
 Source parseOne(const std::string path, const arbiter::Arbiter& a)
 {
     Source source(path);
@@ -341,6 +388,7 @@ SourceList analyze(
     SourceList sources(filenames.begin(), filenames.end());
 
     uint64_t i(0);
+    TemplateCache templates;
 
     Pool pool(threads);
     for (Source& source : sources)
@@ -363,7 +411,8 @@ SourceList analyze(
                 source.info = analyzeOne(
                     handle.localPath(),
                     deep,
-                    pipelineTemplate);
+                    pipelineTemplate,
+                    templates);
             });
         }
     }
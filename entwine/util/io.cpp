@@ -14,6 +14,7 @@
 #include <pdal/util/OStream.hpp>
 
 #include <chrono>
+#include <fstream>
 #include <mutex>
 #include <thread>
 
@@ -58,7 +59,7 @@ bool loop(F f, const int tries, std::string message = "")
     return false;
 }
 
-arbiter::http::Headers getRangeHeader(int start, int end = 0)
+arbiter::http::Headers getRangeHeader(uint64_t start, uint64_t end = 0)
 {
     arbiter::http::Headers h;
     h["Range"] = "bytes=" + std::to_string(start) + "-" +
@@ -157,6 +158,51 @@ std::vector<char> ensureGetBinary(
     else throw FatalError("Failed to get " + path);
 }
 
+std::vector<char> ensureGetRange(
+    const arbiter::Endpoint& ep,
+    const std::string& path,
+    const uint64_t begin,
+    const uint64_t end,
+    const int tries)
+{
+    if (begin == end) return { };
+
+    std::vector<char> data;
+    const auto f = [&ep, &path, &data, begin, end]()
+    {
+        if (ep.isHttpDerived())
+        {
+            data = ep.getBinary(path, getRangeHeader(begin, end));
+        }
+        else if (ep.isLocal())
+        {
+            std::ifstream file(ep.fullPath(path), std::ios::binary);
+            data.resize(end - begin);
+            file.seekg(begin);
+            file.read(data.data(), data.size());
+            if (!file) throw std::runtime_error("Failed to read " + path);
+        }
+        else
+        {
+            // No ranged reads here, so fetch the whole file.
+            const std::vector<char> full(ep.getBinary(path));
+            if (full.size() < end) throw std::runtime_error("Invalid range");
+            data.assign(full.begin() + begin, full.begin() + end);
+        }
+
+        if (data.size() != end - begin)
+        {
+            throw std::runtime_error("Invalid range response for " + path);
+        }
+    };
+
+    const std::string message = "Failed to get " + path + " range " +
+        std::to_string(begin) + "-" + std::to_string(end);
+
+    if (loop(f, tries, message)) return data;
+    else throw FatalError("Failed to get " + path);
+}
+
 std::string ensureGet(
     const arbiter::Endpoint& ep,
     const std::string& path,
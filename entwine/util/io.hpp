@@ -62,6 +62,14 @@ std::vector<char> ensureGetBinary(
     const arbiter::Endpoint& ep,
     const std::string& path,
     int tries = defaultTries);
+// Get the bytes [begin, end) of a file, with a ranged read where the endpoint
+// supports one.
+std::vector<char> ensureGetRange(
+    const arbiter::Endpoint& ep,
+    const std::string& path,
+    uint64_t begin,
+    uint64_t end,
+    int tries = defaultTries);
 std::string ensureGet(
     const arbiter::Endpoint& ep,
     const std::string& path,
@@ -10,23 +10,77 @@
 
 #pragma once
 
+#include <atomic>
+#include <chrono>
+#include <cstdint>
 #include <mutex>
 
 namespace entwine
 {
 
+// A process-wide lock for PDAL operations which are not thread-safe.  Since
+// every thread in the process funnels through this lock, we track how often
+// it is acquired and how long threads spend waiting for it.
 class PdalMutex
 {
 public:
-    static std::mutex& get()
+    static PdalMutex& get()
     {
         static PdalMutex instance;
-        return instance.mutex;
+        return instance;
+    }
+
+    void lock()
+    {
+        ++m_acquired;
+        if (m_mutex.try_lock()) return;
+
+        using Clock = std::chrono::steady_clock;
+        const auto start = Clock::now();
+        m_mutex.lock();
+        const auto waited = Clock::now() - start;
+
+        ++m_contended;
+        m_waited += std::chrono::duration_cast<std::chrono::microseconds>(
+            waited).count();
+    }
+
+    bool try_lock()
+    {
+        if (!m_mutex.try_lock()) return false;
+        ++m_acquired;
+        return true;
+    }
+
+    void unlock() { m_mutex.unlock(); }
+
+    struct Info
+    {
+        uint64_t acquired = 0;
+        uint64_t contended = 0;
+        uint64_t waitedUs = 0;
+    };
+
+    static Info info()
+    {
+        const PdalMutex& m(get());
+        Info info;
+        info.acquired = m.m_acquired;
+        info.contended = m.m_contended;
+        info.waitedUs = m.m_waited;
+        return info;
     }
 
 private:
     PdalMutex() = default;
-    std::mutex mutex;
+
+    std::mutex m_mutex;
+    std::atomic<uint64_t> m_acquired{ 0 };
+    std::atomic<uint64_t> m_contended{ 0 };
+    std::atomic<uint64_t> m_waited{ 0 };
 };
 
+using PdalLock = std::unique_lock<PdalMutex>;
+using PdalGuard = std::lock_guard<PdalMutex>;
+
 } // namespace entwine
@@ -0,0 +1,146 @@
+/******************************************************************************
+* Copyright (c) 2020, Connor Manning (connor@hobu.co)
+*
+* Entwine -- Point cloud indexing
+*
+* Entwine is available under the terms of the LGPL2 license. See COPYING
+* for specific license text and more information.
+*
+******************************************************************************/
+
+#include <entwine/util/pipeline-template.hpp>
+
+#include <sstream>
+#include <stdexcept>
+
+#include <pdal/PipelineManager.hpp>
+
+#include <entwine/util/pdal-mutex.hpp>
+#include <entwine/util/pipeline.hpp>
+#include <entwine/util/unique.hpp>
+
+namespace entwine
+{
+
+json toTemplate(json pipeline, const std::string filename)
+{
+    if (!pipeline.is_array() || pipeline.empty())
+    {
+        throw std::runtime_error("Invalid pipeline: " + pipeline.dump(2));
+    }
+
+    json& reader(pipeline.at(0));
+    reader.erase("filename");
+    if (!reader.count("type"))
+    {
+        const std::string type(pdal::StageFactory::inferReaderDriver(filename));
+        if (type.empty())
+        {
+            throw std::runtime_error("Could not infer reader for " + filename);
+        }
+        reader["type"] = type;
+    }
+
+    return pipeline;
+}
+
+PipelineTemplate::PipelineTemplate(const json pipeline)
+    : m_pipeline(pipeline)
+{
+    if (!m_pipeline.is_array() || m_pipeline.empty())
+    {
+        throw std::runtime_error("Invalid pipeline: " + m_pipeline.dump(2));
+    }
+
+    for (const json& stage : m_pipeline)
+    {
+        if (!stage.is_object() || !stage.count("type"))
+        {
+            throw std::runtime_error(
+                "Pipeline template stages must be typed: " + stage.dump());
+        }
+        if (stage.count("inputs"))
+        {
+            throw std::runtime_error("Invalid pipeline - must be linear");
+        }
+    }
+
+    // Let PDAL parse and validate everything once up front, so that any errors
+    // surface here rather than per file.  The options of each stage are taken
+    // from PDAL's own parse, so they match those of a PDAL pipeline exactly.
+    PdalGuard lock(PdalMutex::get());
+
+    pdal::PipelineManager pm;
+    std::istringstream iss(m_pipeline.dump());
+    pm.readPipeline(iss);
+    pm.validateStageOptions();
+
+    pdal::Stage* stage(&getStage(pm));
+    getReader(*stage);
+    m_streamable = pm.pipelineStreamable();
+
+    std::vector<Spec> specs;
+    while (stage)
+    {
+        specs.push_back({ stage->getName(), stage->getOptions() });
+        const auto& inputs(stage->getInputs());
+        stage = inputs.empty() ? nullptr : inputs.front();
+    }
+
+    m_reader = specs.back();
+    m_filters.assign(specs.rbegin() + 1, specs.rend());
+}
+
+std::unique_ptr<PipelineTemplate::Chain> PipelineTemplate::instantiate(
+    const std::string filename,
+    const pdal::Options& readerOverrides) const
+{
+    auto chain = makeUnique<Chain>();
+
+    pdal::Options readerOptions(m_reader.options);
+    for (const pdal::Option& option : readerOverrides.getOptions())
+    {
+        readerOptions.replace(option);
+    }
+    readerOptions.replace("filename", filename);
+
+    chain->m_last = &create(*chain, m_reader, readerOptions);
+    for (const Spec& spec : m_filters)
+    {
+        pdal::Stage& filter(create(*chain, spec, spec.options));
+        filter.setInput(*chain->m_last);
+        chain->m_last = &filter;
+    }
+
+    return chain;
+}
+
+std::unique_ptr<PipelineTemplate::Chain> PipelineTemplate::instantiateFilters(
+    pdal::Stage& input) const
+{
+    auto chain = makeUnique<Chain>();
+
+    chain->m_last = &input;
+    for (const Spec& spec : m_filters)
+    {
+        pdal::Stage& filter(create(*chain, spec, spec.options));
+        filter.setInput(*chain->m_last);
+        chain->m_last = &filter;
+    }
+
+    return chain;
+}
+
+pdal::Stage& PipelineTemplate::create(
+    Chain& chain,
+    const Spec& spec,
+    const pdal::Options& options) const
+{
+    // Stages are owned by the chain's factory.
+    pdal::Stage* stage(chain.m_factory.createStage(spec.type));
+    if (!stage) throw std::runtime_error("Could not create " + spec.type);
+    stage->setOptions(options);
+    return *stage;
+}
+
+} // namespace entwine
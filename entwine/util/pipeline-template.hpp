@@ -0,0 +1,84 @@
+/******************************************************************************
+* Copyright (c) 2020, Connor Manning (connor@hobu.co)
+*
+* Entwine -- Point cloud indexing
+*
+* Entwine is available under the terms of the LGPL2 license. See COPYING
+* for specific license text and more information.
+*
+******************************************************************************/
+
+#pragma once
+
+#include <memory>
+#include <string>
+#include <vector>
+
+#include <pdal/Options.hpp>
+#include <pdal/Stage.hpp>
+#include <pdal/StageFactory.hpp>
+
+#include <entwine/util/json.hpp>
+
+namespace entwine
+{
+
+// Strip the filename from a pipeline and make its reader type explicit, so
+// that the result may be shared by every file of the same format.
+json toTemplate(json pipeline, std::string filename);
+
+// A linear pipeline which is parsed and validated once, under the global PDAL
+// lock, and then instantiated per file without taking that lock.  Preparing
+// an instantiated chain still requires the lock.
+class PipelineTemplate
+{
+public:
+    // The reader of this pipeline must have an explicit type - see
+    // toTemplate.
+    explicit PipelineTemplate(json pipeline);
+
+    class Chain
+    {
+    public:
+        pdal::Stage& last() { return *m_last; }
+
+    private:
+        friend class PipelineTemplate;
+
+        pdal::StageFactory m_factory;
+        pdal::Stage* m_last = nullptr;
+    };
+
+    // Create a full stage chain reading from this filename.  Any options in
+    // readerOverrides take precedence over those of the template's reader.
+    std::unique_ptr<Chain> instantiate(
+        std::string filename,
+        const pdal::Options& readerOverrides = pdal::Options()) const;
+
+    // Create a chain of only the filters of this template, with the first
+    // filter reading from the given input.
+    std::unique_ptr<Chain> instantiateFilters(pdal::Stage& input) const;
+
+    const json& pipeline() const { return m_pipeline; }
+    bool streamable() const { return m_streamable; }
+
+private:
+    // A stage type and its options, as parsed by PDAL.
+    struct Spec
+    {
+        std::string type;
+        pdal::Options options;
+    };
+
+    pdal::Stage& create(
+        Chain& chain,
+        const Spec& spec,
+        const pdal::Options& options) const;
+
+    const json m_pipeline;
+    Spec m_reader;
+    std::vector<Spec> m_filters;
+    bool m_streamable = false;
+};
+
+} // namespace entwine
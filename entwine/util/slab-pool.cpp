@@ -0,0 +1,216 @@
+/******************************************************************************
+* Copyright (c) 2020, Connor Manning (connor@hobu.co)
+*
+* Entwine -- Point cloud indexing
+*
+* Entwine is available under the terms of the LGPL2 license. See COPYING
+* for specific license text and more information.
+*
+******************************************************************************/
+
+#include <entwine/util/slab-pool.hpp>
+
+#include <algorithm>
+#include <cstdlib>
+#include <new>
+
+#ifdef __linux__
+#include <sys/mman.h>
+#endif
+
+namespace entwine
+{
+
+namespace
+{
+
+const uint64_t arenaSize(64ull << 20);
+const uint64_t hugePageSize(2ull << 20);
+const uint64_t slabAlignment(64);
+
+// Free slabs of each size to keep per thread before handing them back to the
+// shared lists.
+const std::size_t threadCacheSize(8);
+
+uint64_t roundUp(uint64_t v, uint64_t to) { return (v + to - 1) / to * to; }
+
+char* allocateArena(uint64_t bytes, bool hugePages)
+{
+    void* p(nullptr);
+
+#ifdef _WIN32
+    p = _aligned_malloc(bytes, hugePageSize);
+#else
+    if (posix_memalign(&p, hugePageSize, bytes)) p = nullptr;
+#endif
+
+    if (!p) throw std::bad_alloc();
+
+#if defined(__linux__) && defined(MADV_HUGEPAGE)
+    if (hugePages) madvise(p, bytes, MADV_HUGEPAGE);
+#endif
+
+    return static_cast<char*>(p);
+}
+
+void freeArena(char* p)
+{
+#ifdef _WIN32
+    _aligned_free(p);
+#else
+    free(p);
+#endif
+}
+
+class ThreadCache
+{
+public:
+    ~ThreadCache()
+    {
+        sync();
+        for (auto& p : m_free)
+        {
+            for (char* slab : p.second)
+            {
+                SlabPool::get().releaseShared(slab, p.first);
+            }
+        }
+    }
+
+    char* acquire(uint64_t bytes)
+    {
+        sync();
+        std::vector<char*>& list(m_free[bytes]);
+        if (list.empty()) return SlabPool::get().acquireShared(bytes);
+
+        char* slab(list.back());
+        list.pop_back();
+        return slab;
+    }
+
+    void release(char* slab, uint64_t bytes)
+    {
+        sync();
+        std::vector<char*>& list(m_free[bytes]);
+        if (list.size() < threadCacheSize) list.push_back(slab);
+        else SlabPool::get().releaseShared(slab, bytes);
+    }
+
+private:
+    // Our slabs are gone if the pool has been trimmed since we cached them.
+    void sync()
+    {
+        const uint64_t generation(SlabPool::get().generation());
+        if (generation == m_generation) return;
+        m_free.clear();
+        m_generation = generation;
+    }
+
+    // Typically there are only a couple of distinct sizes in a process.
+    std::map<uint64_t, std::vector<char*>> m_free;
+    uint64_t m_generation = 0;
+};
+
+ThreadCache& threadCache()
+{
+    static thread_local ThreadCache cache;
+    return cache;
+}
+
+} // unnamed namespace
+
+SlabPool& SlabPool::get()
+{
+    static SlabPool pool;
+    return pool;
+}
+
+SlabPool::~SlabPool()
+{
+    for (char* arena : m_arenas) freeArena(arena);
+}
+
+char* SlabPool::acquire(uint64_t bytes)
+{
+    bytes = roundUp(bytes, slabAlignment);
+    m_outstanding += bytes;
+    return threadCache().acquire(bytes);
+}
+
+void SlabPool::release(char* slab, uint64_t bytes)
+{
+    bytes = roundUp(bytes, slabAlignment);
+    m_outstanding -= bytes;
+    threadCache().release(slab, bytes);
+}
+
+char* SlabPool::acquireShared(const uint64_t bytes)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    std::vector<char*>& list(m_free[bytes]);
+    if (list.empty()) return carve(bytes);
+
+    char* slab(list.back());
+    list.pop_back();
+    return slab;
+}
+
+void SlabPool::releaseShared(char* slab, const uint64_t bytes)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_free[bytes].push_back(slab);
+}
+
+char* SlabPool::carve(const uint64_t bytes)
+{
+    // Oversized slabs get an arena of their own.
+    if (bytes > arenaSize)
+    {
+        const uint64_t size(roundUp(bytes, hugePageSize));
+        m_arenas.push_back(allocateArena(size, m_hugePages));
+        m_reserved += size;
+        m_carved += bytes;
+        return m_arenas.back();
+    }
+
+    // The tail of the current arena is abandoned if this slab doesn't fit.
+    if (static_cast<uint64_t>(m_end - m_pos) < bytes)
+    {
+        m_arenas.push_back(allocateArena(arenaSize, m_hugePages));
+        m_reserved += arenaSize;
+        m_pos = m_arenas.back();
+        m_end = m_pos + arenaSize;
+    }
+
+    char* slab(m_pos);
+    m_pos += bytes;
+    m_carved += bytes;
+    return slab;
+}
+
+bool SlabPool::trim()
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    if (m_outstanding) return false;
+
+    for (char* arena : m_arenas) freeArena(arena);
+    m_arenas.clear();
+    m_free.clear();
+    m_pos = nullptr;
+    m_end = nullptr;
+    m_carved = 0;
+    m_reserved = 0;
+    ++m_generation;
+    return true;
+}
+
+SlabPool::Info SlabPool::info() const
+{
+    Info info;
+    info.outstanding = m_outstanding;
+    info.free = m_carved - std::min<uint64_t>(m_carved, info.outstanding);
+    info.reserved = m_reserved;
+    return info;
+}
+
+} // namespace entwine
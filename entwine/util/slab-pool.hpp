@@ -0,0 +1,84 @@
+/******************************************************************************
+* Copyright (c) 2020, Connor Manning (connor@hobu.co)
+*
+* Entwine -- Point cloud indexing
+*
+* Entwine is available under the terms of the LGPL2 license. See COPYING
+* for specific license text and more information.
+*
+******************************************************************************/
+
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <map>
+#include <mutex>
+#include <vector>
+
+namespace entwine
+{
+
+// A process-wide pool of fixed-size slabs for point storage.  Over a long
+// build, chunks are constantly created and serialized, and handing their
+// storage back and forth with the system allocator fragments the heap until
+// the resident size is far above the live data.  Instead, slabs are carved
+// from large arenas and recycled by size.  Arenas are only returned to the
+// system by trim, once every slab has been released.
+//
+// Each thread caches a few free slabs of each size, so most acquisitions and
+// releases don't touch the shared free lists.
+class SlabPool
+{
+public:
+    static SlabPool& get();
+
+    ~SlabPool();
+
+    char* acquire(uint64_t bytes);
+    void release(char* slab, uint64_t bytes);
+
+    // Request transparent huge pages for arenas allocated after this call.
+    // This has no effect on platforms without madvise(MADV_HUGEPAGE).
+    void setHugePages(bool enable) { m_hugePages = enable; }
+
+    struct Info
+    {
+        uint64_t outstanding = 0;   // Bytes of slabs currently acquired.
+        uint64_t free = 0;          // Bytes of slabs available for reuse.
+        uint64_t reserved = 0;      // Bytes of arenas allocated.
+    };
+
+    Info info() const;
+
+    // Free every arena, if no slabs are outstanding, and return whether we
+    // did.  Slabs cached by other threads are dropped without being touched,
+    // but those threads must not be using the pool during this call.
+    bool trim();
+
+    // Used by the per-thread caches.
+    void releaseShared(char* slab, uint64_t bytes);
+    char* acquireShared(uint64_t bytes);
+
+    // Incremented by each trim, after which cached slabs are invalid.
+    uint64_t generation() const { return m_generation; }
+
+private:
+    SlabPool() = default;
+
+    char* carve(uint64_t bytes);
+
+    mutable std::mutex m_mutex;
+    std::map<uint64_t, std::vector<char*>> m_free;
+    std::vector<char*> m_arenas;
+    char* m_pos = nullptr;
+    char* m_end = nullptr;
+    std::atomic<bool> m_hugePages{ false };
+    std::atomic<uint64_t> m_generation{ 0 };
+
+    std::atomic<uint64_t> m_outstanding{ 0 };
+    std::atomic<uint64_t> m_carved{ 0 };
+    std::atomic<uint64_t> m_reserved{ 0 };
+};
+
+} // namespace entwine
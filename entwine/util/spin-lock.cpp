@@ -0,0 +1,122 @@
+/******************************************************************************
+* Copyright (c) 2020, Connor Manning (connor@hobu.co)
+*
+* Entwine -- Point cloud indexing
+*
+* Entwine is available under the terms of the LGPL2 license. See COPYING
+* for specific license text and more information.
+*
+******************************************************************************/
+
+#include <entwine/util/spin-lock.hpp>
+
+#include <algorithm>
+#include <chrono>
+#include <thread>
+
+#if defined(__x86_64__) || defined(__i386__) || defined(_M_X64) || \
+    defined(_M_IX86)
+#include <immintrin.h>
+#endif
+
+namespace entwine
+{
+
+namespace
+{
+
+// Spin rounds double their pause count up to this limit, after which we yield
+// for a while and then park.
+const uint64_t spinRounds(10);
+const uint64_t yieldRounds(64);
+const std::chrono::microseconds parkTime(50);
+
+inline void pause()
+{
+#if defined(__x86_64__) || defined(__i386__) || defined(_M_X64) || \
+    defined(_M_IX86)
+    _mm_pause();
+#elif defined(__aarch64__) || defined(__arm__)
+    __asm__ __volatile__("yield");
+#endif
+}
+
+} // unnamed namespace
+
+LockSite::Info LockSite::info() const
+{
+    Info info;
+    info.name = name;
+    info.contended = contended;
+    info.parked = parked;
+    info.waitedUs = waitedUs;
+    return info;
+}
+
+namespace locks
+{
+
+LockSite generic("generic");
+LockSite shard("shard");
+LockSite owned("owned");
+LockSite chunk("chunk");
+LockSite overflow("overflow");
+LockSite voxel("voxel");
+LockSite hierarchy("hierarchy");
+
+std::vector<LockSite::Info> info()
+{
+    return {
+        generic.info(),
+        shard.info(),
+        owned.info(),
+        chunk.info(),
+        overflow.info(),
+        voxel.info(),
+        hierarchy.info()
+    };
+}
+
+} // namespace locks
+
+#ifndef SPINLOCK_AS_MUTEX
+
+void SpinLock::wait()
+{
+    using Clock = std::chrono::steady_clock;
+    const auto start = Clock::now();
+    bool parked(false);
+
+    for (uint64_t round(0); ; ++round)
+    {
+        if (round < spinRounds)
+        {
+            const uint64_t pauses(uint64_t(1) << round);
+            for (uint64_t i(0); i < pauses; ++i) pause();
+        }
+        else if (round < spinRounds + yieldRounds)
+        {
+            std::this_thread::yield();
+        }
+        else
+        {
+            parked = true;
+            std::this_thread::sleep_for(parkTime);
+        }
+
+        // Wait for the lock to look free before trying to take it, so waiters
+        // don't keep stealing its cache line from the holder.
+        if (try_lock()) break;
+    }
+
+    const auto waited = Clock::now() - start;
+
+    ++m_site->contended;
+    if (parked) ++m_site->parked;
+    m_site->waitedUs += std::chrono::duration_cast<std::chrono::microseconds>(
+        waited).count();
+}
+
+#endif
+
+} // namespace entwine
@@ -10,31 +10,100 @@
 
 #pragma once
 
-#ifdef SPINLOCK_AS_MUTEX
-#include <mutex>
-#else
 #include <atomic>
-#endif
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <vector>
 
 namespace entwine
 {
 
+// Locks in arrays, which may be hammered by different threads, should be
+// aligned to this to avoid false sharing.
+static constexpr std::size_t cacheLineSize = 64;
+
+// Contention counts shared by all of the locks guarding the same kind of data.
+// Uncontended acquisitions touch nothing but the lock itself, so only contended
+// acquisitions are counted.
+struct LockSite
+{
+    constexpr LockSite(const char* name) : name(name) { }
+
+    struct Info
+    {
+        std::string name;
+        uint64_t contended = 0;
+        uint64_t parked = 0;
+        uint64_t waitedUs = 0;
+    };
+
+    Info info() const;
+
+    const char* name;
+    std::atomic<uint64_t> contended{ 0 };
+    std::atomic<uint64_t> parked{ 0 };
+    std::atomic<uint64_t> waitedUs{ 0 };
+};
+
+namespace locks
+{
+
+extern LockSite generic;
+extern LockSite shard;      // Chunk cache slice shards.
+extern LockSite owned;      // The chunk cache's list of unreferenced chunks.
+extern LockSite chunk;      // Chunk reference counts and overflow selection.
+extern LockSite overflow;   // Chunk overflow insertion.
+extern LockSite voxel;      // Voxel grid blocks.
+extern LockSite hierarchy;
+
+// Counts for each site, across all threads since the start of the process.
+std::vector<LockSite::Info> info();
+
+} // namespace locks
+
 #ifdef SPINLOCK_AS_MUTEX
 
-using SpinLock = std::mutex;
+class SpinLock : public std::mutex
+{
+public:
+    SpinLock() = default;
+    explicit SpinLock(LockSite&) { }
+};
 
 #else
 
+// A lock for short critical sections.  Acquisition spins briefly with pause
+// instructions and exponential backoff, then yields its time slice, and then
+// parks by sleeping - so a waiter on a lock whose holder has been descheduled
+// or is blocked doesn't burn a whole core.
 class SpinLock
 {
 public:
     SpinLock() = default;
+    explicit SpinLock(LockSite& site) : m_site(&site) { }
+
+    void lock()
+    {
+        if (!m_flag.exchange(true, std::memory_order_acquire)) return;
+        wait();
+    }
 
-    void lock() { while (m_flag.test_and_set()) ; }
-    void unlock() { m_flag.clear(); }
+    bool try_lock()
+    {
+        return
+            !m_flag.load(std::memory_order_relaxed) &&
+            !m_flag.exchange(true, std::memory_order_acquire);
+    }
+
+    void unlock() { m_flag.store(false, std::memory_order_release); }
 
 private:
-    std::atomic_flag m_flag = ATOMIC_FLAG_INIT;
+    void wait();
+
+    std::atomic<bool> m_flag{ false };
+    LockSite* m_site = &locks::generic;
 
     SpinLock(const SpinLock& other) = delete;
 };
@@ -45,4 +114,3 @@ using SpinGuard = std::lock_guard<SpinLock>;
 using UniqueSpin = std::unique_lock<SpinLock>;
 
 } // namespace entwine
-
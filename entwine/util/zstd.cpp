@@ -0,0 +1,239 @@
+/******************************************************************************
+* Copyright (c) 2020, Connor Manning (connor@hobu.co)
+*
+* Entwine -- Point cloud indexing
+*
+* Entwine is available under the terms of the LGPL2 license. See COPYING
+* for specific license text and more information.
+*
+******************************************************************************/
+
+#include <entwine/util/zstd.hpp>
+
+#include <stdexcept>
+#include <string>
+
+#include <zdict.h>
+#include <zstd.h>
+
+namespace entwine
+{
+namespace zstd
+{
+
+namespace
+{
+
+std::size_t check(const std::size_t result)
+{
+    if (ZSTD_isError(result))
+    {
+        throw std::runtime_error(
+            std::string("Zstandard error: ") + ZSTD_getErrorName(result));
+    }
+    return result;
+}
+
+struct Contexts
+{
+    ~Contexts()
+    {
+        ZSTD_freeCCtx(compress);
+        ZSTD_freeDCtx(decompress);
+    }
+
+    ZSTD_CCtx* compress = nullptr;
+    ZSTD_DCtx* decompress = nullptr;
+};
+
+Contexts& contexts()
+{
+    static thread_local Contexts c;
+    return c;
+}
+
+ZSTD_CCtx* compressContext()
+{
+    Contexts& c(contexts());
+    if (!c.compress) c.compress = ZSTD_createCCtx();
+    if (!c.compress)
+    {
+        throw std::runtime_error("Failed to create zstd compression context");
+    }
+    return c.compress;
+}
+
+ZSTD_DCtx* decompressContext()
+{
+    Contexts& c(contexts());
+    if (!c.decompress) c.decompress = ZSTD_createDCtx();
+    if (!c.decompress)
+    {
+        throw std::runtime_error("Failed to create zstd decompression context");
+    }
+    return c.decompress;
+}
+
+} // unnamed namespace
+
+Dictionary::Dictionary(std::vector<char> data, const int level)
+    : m_data(std::move(data))
+    , m_compression(ZSTD_createCDict(m_data.data(), m_data.size(), level))
+    , m_decompression(ZSTD_createDDict(m_data.data(), m_data.size()))
+{
+    if (!m_compression || !m_decompression)
+    {
+        ZSTD_freeCDict(m_compression);
+        ZSTD_freeDDict(m_decompression);
+        throw std::runtime_error("Failed to create zstd dictionary");
+    }
+}
+
+Dictionary::~Dictionary()
+{
+    ZSTD_freeCDict(m_compression);
+    ZSTD_freeDDict(m_decompression);
+}
+
+std::vector<char> Dictionary::train(
+    const std::vector<char>& samples,
+    const std::vector<std::size_t>& sizes,
+    const std::size_t capacity)
+{
+    std::vector<char> data(capacity);
+    const std::size_t result(
+        ZDICT_trainFromBuffer(
+            data.data(),
+            data.size(),
+            samples.data(),
+            sizes.data(),
+            static_cast<unsigned>(sizes.size())));
+
+    if (ZDICT_isError(result)) return { };
+
+    data.resize(result);
+    return data;
+}
+
+Compressor::Compressor(const Options& options, const uint64_t size)
+{
+    ZSTD_CCtx* ctx(compressContext());
+    check(ZSTD_CCtx_reset(ctx, ZSTD_reset_session_and_parameters));
+    check(ZSTD_CCtx_setParameter(ctx, ZSTD_c_compressionLevel, options.level));
+    check(ZSTD_CCtx_setParameter(
+        ctx,
+        ZSTD_c_enableLongDistanceMatching,
+        options.longDistance ? 1 : 0));
+
+    // This fails if the library doesn't support multithreading, in which case
+    // we just compress on this thread.
+    if (options.threads)
+    {
+        ZSTD_CCtx_setParameter(
+            ctx,
+            ZSTD_c_nbWorkers,
+            static_cast<int>(options.threads));
+    }
+
+    if (options.dictionary)
+    {
+        check(ZSTD_CCtx_refCDict(ctx, options.dictionary->compression()));
+    }
+
+    if (size) check(ZSTD_CCtx_setPledgedSrcSize(ctx, size));
+}
+
+void Compressor::add(const char* pos, const std::size_t size)
+{
+    stream(pos, size, false);
+}
+
+std::vector<char> Compressor::done()
+{
+    stream(nullptr, 0, true);
+    m_out.shrink_to_fit();
+    return std::move(m_out);
+}
+
+void Compressor::stream(const char* pos, const std::size_t size, bool end)
+{
+    ZSTD_CCtx* ctx(compressContext());
+    ZSTD_inBuffer in { pos, size, 0 };
+    const ZSTD_EndDirective mode(end ? ZSTD_e_end : ZSTD_e_continue);
+    const std::size_t step(ZSTD_CStreamOutSize());
+
+    bool finished(false);
+    while (!finished)
+    {
+        const std::size_t start(m_out.size());
+        m_out.resize(start + step);
+
+        ZSTD_outBuffer out { m_out.data() + start, step, 0 };
+        const std::size_t remaining(
+            check(ZSTD_compressStream2(ctx, &out, &in, mode)));
+        m_out.resize(start + out.pos);
+
+        finished = end ? remaining == 0 : in.pos == in.size;
+    }
+}
+
+std::vector<char> compress(
+    const char* pos,
+    const std::size_t size,
+    const Options& options)
+{
+    Compressor compressor(options, size);
+    compressor.add(pos, size);
+    return compressor.done();
+}
+
+void decompress(
+    const char* pos,
+    const std::size_t size,
+    char* dst,
+    const std::size_t dstSize,
+    const Dictionary* dictionary)
+{
+    ZSTD_DCtx* ctx(decompressContext());
+    const std::size_t result(
+        dictionary && dictionaryId(pos, size)
+            ? check(
+                ZSTD_decompress_usingDDict(
+                    ctx,
+                    dst,
+                    dstSize,
+                    pos,
+                    size,
+                    dictionary->decompression()))
+            : check(ZSTD_decompressDCtx(ctx, dst, dstSize, pos, size)));
+
+    if (result != dstSize)
+    {
+        throw std::runtime_error(
+            "Zstandard data decompressed to " + std::to_string(result) +
+            " bytes, expected " + std::to_string(dstSize));
+    }
+}
+
+std::vector<char> decompress(
+    const std::vector<char>& compressed,
+    const std::size_t size,
+    const Dictionary* dictionary)
+{
+    std::vector<char> data(size);
+    decompress(
+        compressed.data(),
+        compressed.size(),
+        data.data(),
+        size,
+        dictionary);
+    return data;
+}
+
+unsigned dictionaryId(const char* pos, const std::size_t size)
+{
+    return ZSTD_getDictID_fromFrame(pos, size);
+}
+
+} // namespace zstd
+} // namespace entwine
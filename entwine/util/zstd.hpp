@@ -0,0 +1,121 @@
+/******************************************************************************
+* Copyright (c) 2020, Connor Manning (connor@hobu.co)
+*
+* Entwine -- Point cloud indexing
+*
+* Entwine is available under the terms of the LGPL2 license. See COPYING
+* for specific license text and more information.
+*
+******************************************************************************/
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+struct ZSTD_CDict_s;
+struct ZSTD_DDict_s;
+
+namespace entwine
+{
+namespace zstd
+{
+
+// A dictionary for compressing many small frames of similar data, digested
+// once for both compression, at a fixed level, and decompression.
+class Dictionary
+{
+public:
+    Dictionary(std::vector<char> data, int level);
+    ~Dictionary();
+
+    Dictionary(const Dictionary&) = delete;
+    Dictionary& operator=(const Dictionary&) = delete;
+
+    // Train a dictionary of at most capacity bytes from the concatenated
+    // samples, whose individual sizes are given.  Returns an empty result if
+    // the samples are not sufficient to train a useful dictionary.
+    static std::vector<char> train(
+        const std::vector<char>& samples,
+        const std::vector<std::size_t>& sizes,
+        std::size_t capacity);
+
+    const std::vector<char>& data() const { return m_data; }
+    const ZSTD_CDict_s* compression() const { return m_compression; }
+    const ZSTD_DDict_s* decompression() const { return m_decompression; }
+
+private:
+    const std::vector<char> m_data;
+    ZSTD_CDict_s* m_compression = nullptr;
+    ZSTD_DDict_s* m_decompression = nullptr;
+};
+
+struct Options
+{
+    Options() = default;
+    explicit Options(int level) : level(level) { }
+    Options(int level, bool longDistance, uint64_t threads)
+        : level(level)
+        , longDistance(longDistance)
+        , threads(threads)
+    { }
+
+    int level = 3; // ZSTD_CLEVEL_DEFAULT.
+    bool longDistance = false;
+
+    // Worker threads for a single frame, with zero compressing on the calling
+    // thread.  Ignored if the zstd library was built without multithreading.
+    uint64_t threads = 0;
+
+    // If set, this must outlive any compression using these options.
+    const Dictionary* dictionary = nullptr;
+};
+
+// Streams data into a single zstd frame.  Compression contexts are expensive
+// to create, so each thread reuses its own - which means that only one
+// Compressor may be alive at a time on a given thread.
+class Compressor
+{
+public:
+    // If the total input size is known, it is recorded in the frame header.
+    explicit Compressor(const Options& options, uint64_t size = 0);
+
+    Compressor(const Compressor&) = delete;
+    Compressor& operator=(const Compressor&) = delete;
+
+    void add(const char* pos, std::size_t size);
+    std::vector<char> done();
+
+private:
+    void stream(const char* pos, std::size_t size, bool end);
+
+    std::vector<char> m_out;
+};
+
+std::vector<char> compress(
+    const char* pos,
+    std::size_t size,
+    const Options& options = Options());
+
+// Decompress into a buffer of exactly the decompressed size, which must be
+// known up front.  Throws if the data does not decompress to exactly this
+// size.  The dictionary is used only if the frame was compressed with one.
+void decompress(
+    const char* pos,
+    std::size_t size,
+    char* dst,
+    std::size_t dstSize,
+    const Dictionary* dictionary = nullptr);
+
+std::vector<char> decompress(
+    const std::vector<char>& compressed,
+    std::size_t size,
+    const Dictionary* dictionary = nullptr);
+
+// The ID of the dictionary with which this frame was compressed, or zero if
+// it was compressed without one.
+unsigned dictionaryId(const char* pos, std::size_t size);
+
+} // namespace zstd
+} // namespace entwine
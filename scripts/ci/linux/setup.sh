@@ -4,7 +4,7 @@ echo "Configuring build type '$BUILD_TYPE'"
 mkdir build
 
 conda update -n base -c defaults conda
-conda install cmake ninja compilers -y
+conda install cmake ninja compilers zstd -y
 
 if [ "$BUILD_TYPE" == "fixed" ]; then
 
@@ -0,0 +1,248 @@
+#include "gtest/gtest.h"
+#include "config.hpp"
+#include "fixture.hpp"
+
+#include <cstring>
+#include <random>
+#include <set>
+#include <string>
+#include <vector>
+
+#include <entwine/io/columnar.hpp>
+#include <entwine/util/io.hpp>
+
+using namespace entwine;
+
+namespace
+{
+    const std::string outPath(test::dataPath() + "out/columnar/");
+    const std::string filename("0-0-0-0");
+    const uint64_t np(1000);
+
+    const Schema schema {
+        { "X", Type::Double },
+        { "Y", Type::Double },
+        { "Z", Type::Double },
+        { "Intensity", Type::Unsigned16 },
+        { "Classification", Type::Unsigned8 },
+        { "GpsTime", Type::Double }
+    };
+
+    // Random records, with the doubles drawn from a sensible range.
+    std::vector<char> makeRecords()
+    {
+        std::mt19937 gen(42);
+        std::uniform_real_distribution<double> dist(0, 100);
+
+        const uint64_t pointSize(getPointSize(schema));
+        std::vector<char> records(test::makeRecords(schema, np));
+
+        for (uint64_t i(0); i < np; ++i)
+        {
+            for (const std::string name : { "X", "Y", "Z", "GpsTime" })
+            {
+                const double v(dist(gen));
+                std::memcpy(
+                    records.data() + i * pointSize + getOffset(schema, name),
+                    &v,
+                    sizeof(v));
+            }
+        }
+        return records;
+    }
+
+    void write(const Metadata& metadata, std::vector<char>& records)
+    {
+        auto layout = toLayout(metadata.memorySchema);
+        BlockPointTable table(layout);
+
+        const uint64_t pointSize(getPointSize(schema));
+        for (uint64_t i(0); i < np; ++i)
+        {
+            table.insert(records.data() + i * pointSize);
+        }
+
+        io::write(
+            io::Type::Columnar,
+            metadata,
+            test::makeEndpoints(outPath),
+            filename,
+            table,
+            test::cube());
+    }
+
+    template <typename F>
+    std::vector<char> read(const Metadata& metadata, F f)
+    {
+        auto layout = toLayout(metadata.memorySchema);
+        VectorPointTable table(layout, np);
+
+        std::vector<char> result;
+        table.setProcess([&]()
+        {
+            const char* pos(table.data().data());
+            result.insert(
+                result.end(),
+                pos,
+                pos + table.numPoints() * table.pointSize());
+        });
+
+        f(table);
+        return result;
+    }
+
+    // The given dimensions of each record, since points are reordered by the
+    // columnar format.
+    std::multiset<std::string> select(
+        const std::vector<char>& records,
+        const StringList& dimensions)
+    {
+        const uint64_t pointSize(getPointSize(schema));
+
+        std::multiset<std::string> result;
+        for (uint64_t i(0); i < records.size(); i += pointSize)
+        {
+            std::string s;
+            for (const std::string& name : dimensions)
+            {
+                const char* pos(records.data() + i + getOffset(schema, name));
+                s.append(pos, size(find(schema, name).type));
+            }
+            result.insert(s);
+        }
+        return result;
+    }
+
+    StringList names()
+    {
+        StringList result;
+        for (const Dimension& d : schema) result.push_back(d.name);
+        return result;
+    }
+}
+
+TEST(columnar, readAll)
+{
+    const Metadata metadata(test::makeMetadata(schema, io::Type::Columnar));
+    const Endpoints endpoints(test::makeEndpoints(outPath));
+
+    std::vector<char> records(makeRecords());
+    write(metadata, records);
+
+    const std::vector<char> result(read(metadata, [&](VectorPointTable& t)
+    {
+        io::read(io::Type::Columnar, metadata, endpoints, filename, t);
+    }));
+
+    ASSERT_EQ(result.size(), records.size());
+    EXPECT_EQ(select(result, names()), select(records, names()));
+}
+
+TEST(columnar, readDimensions)
+{
+    const Metadata metadata(test::makeMetadata(schema, io::Type::Columnar));
+    const Endpoints endpoints(test::makeEndpoints(outPath));
+
+    std::vector<char> records(makeRecords());
+    write(metadata, records);
+
+    // Both a lone column and a run of adjacent columns.
+    const StringList dimensions { "X", "Intensity", "Classification" };
+    const std::vector<char> result(read(metadata, [&](VectorPointTable& t)
+    {
+        io::columnar::readDimensions(
+            metadata,
+            endpoints,
+            filename,
+            t,
+            dimensions);
+    }));
+
+    ASSERT_EQ(result.size(), records.size());
+    EXPECT_EQ(select(result, dimensions), select(records, dimensions));
+
+    // The remaining dimensions are zeroed.
+    for (const std::string name : { "Y", "Z", "GpsTime" })
+    {
+        const std::string zero(size(find(schema, name).type), 0);
+        const auto selected(select(result, { name }));
+        EXPECT_EQ(selected.count(zero), np) << name;
+    }
+}
+
+TEST(columnar, invalidDimension)
+{
+    const Metadata metadata(test::makeMetadata(schema, io::Type::Columnar));
+    const Endpoints endpoints(test::makeEndpoints(outPath));
+
+    std::vector<char> records(makeRecords());
+    write(metadata, records);
+
+    EXPECT_ANY_THROW(read(metadata, [&](VectorPointTable& t)
+    {
+        io::columnar::readDimensions(
+            metadata,
+            endpoints,
+            filename,
+            t,
+            { "X", "Asdf" });
+    }));
+}
+
+TEST(columnar, truncated)
+{
+    const Metadata metadata(test::makeMetadata(schema, io::Type::Columnar));
+    const Endpoints endpoints(test::makeEndpoints(outPath));
+
+    std::vector<char> records(makeRecords());
+    write(metadata, records);
+
+    const std::string path(filename + ".col");
+    std::vector<char> data(endpoints.data.getBinary(path));
+    data.resize(data.size() / 2);
+    endpoints.data.put(path, data);
+
+    EXPECT_ANY_THROW(read(metadata, [&](VectorPointTable& t)
+    {
+        io::read(io::Type::Columnar, metadata, endpoints, filename, t);
+    }));
+
+    // An index which points beyond the end of the node.
+    data.resize(sizeof(uint64_t) * 2 + schema.size() * sizeof(uint64_t) * 2);
+    const uint64_t offset(1ull << 40);
+    std::memcpy(data.data() + sizeof(uint64_t) * 2, &offset, sizeof(offset));
+    endpoints.data.put(path, data);
+
+    EXPECT_ANY_THROW(read(metadata, [&](VectorPointTable& t)
+    {
+        io::read(io::Type::Columnar, metadata, endpoints, filename, t);
+    }));
+}
+
+TEST(columnar, getRange)
+{
+    const Endpoints endpoints(test::makeEndpoints(outPath));
+
+    std::vector<char> data(1000);
+    for (std::size_t i(0); i < data.size(); ++i) data[i] = i % 251;
+    endpoints.data.put("range", data);
+
+    const auto check = [&](uint64_t begin, uint64_t end)
+    {
+        const std::vector<char> range(
+            ensureGetRange(endpoints.data, "range", begin, end));
+        EXPECT_EQ(
+            range,
+            std::vector<char>(data.begin() + begin, data.begin() + end)) <<
+            begin << "-" << end;
+    };
+
+    check(0, 1000);
+    check(0, 1);
+    check(10, 500);
+    check(999, 1000);
+    check(500, 500);
+
+    EXPECT_ANY_THROW(ensureGetRange(endpoints.data, "range", 900, 1001, 1));
+    EXPECT_ANY_THROW(ensureGetRange(endpoints.data, "missing", 0, 10, 1));
+}
@@ -0,0 +1,48 @@
+#include "gtest/gtest.h"
+
+#include <entwine/io/io.hpp>
+
+using namespace entwine;
+
+TEST(dataType, plain)
+{
+    for (const std::string s : { "binary", "laszip", "zstandard", "columnar" })
+    {
+        const io::EptDataType t(io::toEptDataType(s));
+        EXPECT_EQ(io::toString(t.type), s);
+        EXPECT_FALSE(t.zstdShuffle);
+        EXPECT_FALSE(t.zstdDictionary);
+        EXPECT_EQ(io::toString(t), s);
+    }
+}
+
+TEST(dataType, zstandardVariants)
+{
+    // Plain EPT readers must not mistake these for plain zstandard data.
+    for (const bool shuffle : { false, true })
+    {
+        for (const bool dictionary : { false, true })
+        {
+            const io::EptDataType t(io::Type::Zstandard, shuffle, dictionary);
+            const std::string s(io::toString(t));
+            EXPECT_EQ(s == "zstandard", !shuffle && !dictionary);
+
+            const io::EptDataType parsed(io::toEptDataType(s));
+            EXPECT_EQ(parsed.type, io::Type::Zstandard);
+            EXPECT_EQ(parsed.zstdShuffle, shuffle);
+            EXPECT_EQ(parsed.zstdDictionary, dictionary);
+        }
+    }
+
+    EXPECT_EQ(
+        io::toString(io::EptDataType(io::Type::Zstandard, true, true)),
+        "zstandard-dictionary-shuffle");
+}
+
+TEST(dataType, invalid)
+{
+    EXPECT_ANY_THROW(io::toEptDataType("laszip-shuffle"));
+    EXPECT_ANY_THROW(io::toEptDataType("zstandard-shuffle-dictionary"));
+    EXPECT_ANY_THROW(io::toEptDataType("-shuffle"));
+    EXPECT_ANY_THROW(io::toEptDataType("asdf"));
+}
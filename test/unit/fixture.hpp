@@ -0,0 +1,65 @@
+#pragma once
+
+#include <cstdint>
+#include <memory>
+#include <random>
+#include <string>
+#include <vector>
+
+#include <entwine/io/io.hpp>
+#include <entwine/third/arbiter/arbiter.hpp>
+#include <entwine/types/bounds.hpp>
+#include <entwine/types/dimension.hpp>
+#include <entwine/types/endpoints.hpp>
+#include <entwine/types/metadata.hpp>
+
+namespace test
+{
+
+// The cube over which component tests build their metadata.
+inline entwine::Bounds cube()
+{
+    return entwine::Bounds(0, 0, 0, 100, 100, 100);
+}
+
+// Metadata for testing a single component, rather than a full build, with
+// default build parameters.
+inline entwine::Metadata makeMetadata(
+    const entwine::Schema& schema,
+    const entwine::io::Type dataType = entwine::io::Type::Binary)
+{
+    return entwine::Metadata(
+        entwine::currentEptVersion(),
+        schema,
+        cube(),
+        cube(),
+        { },
+        { },
+        dataType,
+        128,
+        entwine::BuildParameters(0, 0));
+}
+
+inline entwine::Endpoints makeEndpoints(
+    const std::string output,
+    const std::string tmp = arbiter::getTempPath())
+{
+    return entwine::Endpoints(
+        std::make_shared<arbiter::Arbiter>(),
+        output,
+        tmp);
+}
+
+// Records of random bytes, the same for a given seed.
+inline std::vector<char> makeRecords(
+    const entwine::Schema& schema,
+    const uint64_t np,
+    const int seed = 42)
+{
+    std::mt19937 gen(seed);
+    std::vector<char> records(np * entwine::getPointSize(schema));
+    for (char& c : records) c = static_cast<char>(gen());
+    return records;
+}
+
+} // namespace test
@@ -0,0 +1,140 @@
+#include "gtest/gtest.h"
+#include "fixture.hpp"
+
+#include <cmath>
+#include <cstring>
+#include <vector>
+
+#include <entwine/builder/insert-batch.hpp>
+#include <entwine/types/vector-point-table.hpp>
+
+using namespace entwine;
+
+namespace
+{
+    // Scaled XYZ which are held as such in memory, and scaled XYZ which are
+    // too wide for that, and so are held as doubles.
+    const Schema narrow {
+        { "X", Type::Signed32, 0.01 },
+        { "Y", Type::Signed32, 0.01 },
+        { "Z", Type::Signed32, 0.01 },
+        { "Intensity", Type::Unsigned16 },
+        { "OriginId", Type::Unsigned32 },
+        { "PointId", Type::Unsigned64 }
+    };
+    const Schema wide {
+        { "X", Type::Signed64, 0.01 },
+        { "Y", Type::Signed64, 0.01 },
+        { "Z", Type::Signed64, 0.01 },
+        { "Intensity", Type::Unsigned16 },
+        { "OriginId", Type::Unsigned32 },
+        { "PointId", Type::Unsigned64 }
+    };
+
+    template <typename T>
+    T get(const Schema& schema, const char* record, std::string name)
+    {
+        T v;
+        std::memcpy(&v, record + getOffset(schema, name), sizeof(T));
+        return v;
+    }
+
+    template <typename T>
+    void set(const Schema& schema, char* record, std::string name, T v)
+    {
+        std::memcpy(record + getOffset(schema, name), &v, sizeof(T));
+    }
+
+    // Some points inside of our test cube, with coordinates between those of
+    // our scale, and some outside of them.
+    const std::vector<Point> points {
+        Point(1.234, 2.345, 3.456),
+        Point(-1, 50, 50),
+        Point(99.994, 0.004, 42),
+        Point(50, 50, 100),
+        Point(10.0051, 20.0049, 30.0062)
+    };
+
+    // Run each step of a batch over a table of our points, with the one at
+    // position skipped marked as such by the reader.
+    template <typename F>
+    void run(const Metadata& metadata, uint64_t skipped, F check)
+    {
+        auto layout = toLayout(metadata.absoluteSchema);
+        VectorPointTable table(layout, points.size());
+        const Schema& schema(metadata.absoluteSchema);
+
+        for (uint64_t i(0); i < points.size(); ++i)
+        {
+            char* record(table.getPoint(i));
+            set(schema, record, "X", points[i].x);
+            set(schema, record, "Y", points[i].y);
+            set(schema, record, "Z", points[i].z);
+            set(schema, record, "Intensity", uint16_t(i));
+        }
+
+        InsertBatch batch(metadata, 7);
+        table.setProcess([&]()
+        {
+            table.setSkip(skipped);
+            EXPECT_EQ(batch.gather(table, 100), points.size() - 1);
+            batch.clip(*getScaleOffset(metadata.schema));
+            batch.filter(metadata.boundsConforming);
+            batch.quantize(metadata.quantizer);
+            batch.convert();
+            check(batch);
+        });
+        table.clear(points.size());
+    }
+}
+
+TEST(insertBatch, stages)
+{
+    for (const Schema& schema : { narrow, wide })
+    {
+        const Metadata metadata(test::makeMetadata(schema));
+        const RecordXyz xyz(metadata.memorySchema);
+        EXPECT_EQ(
+            isScaledInMemory(metadata),
+            find(schema, "X").type == Type::Signed32);
+
+        run(metadata, 2, [&](const InsertBatch& batch)
+        {
+            // The skipped point and the two outside of our bounds are gone.
+            ASSERT_EQ(batch.size(), 2u);
+
+            const std::vector<uint64_t> kept { 0, 4 };
+            for (std::size_t i(0); i < batch.size(); ++i)
+            {
+                const uint64_t o(kept[i]);
+                const Point& p(points[o]);
+                const Point clipped(
+                    std::round(p.x * 100) / 100,
+                    std::round(p.y * 100) / 100,
+                    std::round(p.z * 100) / 100);
+
+                // Coordinates are clipped, both as staged and in the records
+                // from which residents are read back.
+                const Point staged(batch.point(i));
+                EXPECT_NEAR(staged.x, clipped.x, 1e-9);
+                EXPECT_NEAR(staged.y, clipped.y, 1e-9);
+                EXPECT_NEAR(staged.z, clipped.z, 1e-9);
+                EXPECT_EQ(xyz.get(batch.data(i)), staged);
+
+                EXPECT_EQ(
+                    batch.lattice(i),
+                    metadata.quantizer.quantize(staged));
+
+                // PointIds count the points read, skipping only those which
+                // the reader skipped.
+                const Schema& s(metadata.memorySchema);
+                const char* record(batch.data(i));
+                EXPECT_EQ(get<uint16_t>(s, record, "Intensity"), o);
+                EXPECT_EQ(get<uint32_t>(s, record, "OriginId"), 7u);
+                EXPECT_EQ(
+                    get<uint64_t>(s, record, "PointId"),
+                    100 + (o < 2 ? o : o - 1));
+            }
+        });
+    }
+}
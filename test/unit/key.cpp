@@ -0,0 +1,218 @@
+#include "gtest/gtest.h"
+
+#include <cmath>
+#include <limits>
+#include <random>
+
+#include <entwine/types/bounds.hpp>
+#include <entwine/types/dir.hpp>
+#include <entwine/types/key.hpp>
+#include <entwine/types/point.hpp>
+
+using namespace entwine;
+
+namespace
+{
+    // Deliberately not a power of two in size or offset, so the scaling into
+    // the lattice rounds.
+    const Bounds cube(-123.456, 10.1, 1e-3, 876.544, 1010.1, 1000.001);
+    const Quantizer quantizer(cube);
+
+    const double notANumber(std::numeric_limits<double>::quiet_NaN());
+    const double infinity(std::numeric_limits<double>::infinity());
+
+    // The position of a point at a depth by bisecting floating point bounds,
+    // as keys were computed before quantization.
+    Xyz bisect(const Point& g, uint64_t depth)
+    {
+        Bounds b(cube);
+        Xyz p;
+        for (uint64_t d(0); d < depth; ++d)
+        {
+            const Dir dir(getDirection(b.mid(), g));
+            p.x = (p.x << 1) | (isEast(dir)  ? 1u : 0u);
+            p.y = (p.y << 1) | (isNorth(dir) ? 1u : 0u);
+            p.z = (p.z << 1) | (isUp(dir)    ? 1u : 0u);
+            b.go(dir);
+        }
+        return p;
+    }
+
+    Xyz positionOf(const Point& g, uint64_t depth)
+    {
+        Key key(quantizer, 0);
+        key.init(g, depth);
+        return key.position();
+    }
+
+    bool within(const Point& g, const Bounds& b)
+    {
+        return
+            b.min().x <= g.x && g.x < b.max().x &&
+            b.min().y <= g.y && g.y < b.max().y &&
+            b.min().z <= g.z && g.z < b.max().z;
+    }
+
+    std::vector<Point> randomPoints(std::size_t n)
+    {
+        std::mt19937 gen(42);
+        std::uniform_real_distribution<double> x(cube.min().x, cube.max().x);
+        std::uniform_real_distribution<double> y(cube.min().y, cube.max().y);
+        std::uniform_real_distribution<double> z(cube.min().z, cube.max().z);
+
+        std::vector<Point> points;
+        for (std::size_t i(0); i < n; ++i)
+        {
+            points.emplace_back(x(gen), y(gen), z(gen));
+        }
+        return points;
+    }
+}
+
+TEST(key, matchesBisection)
+{
+    // Away from cell edges, which is nearly everywhere, the lattice agrees
+    // with bisection.
+    for (const Point& g : randomPoints(1000))
+    {
+        for (uint64_t depth(0); depth <= 24; ++depth)
+        {
+            ASSERT_EQ(positionOf(g, depth), bisect(g, depth)) <<
+                g << " at " << depth;
+        }
+    }
+}
+
+TEST(key, containment)
+{
+    // At every depth, a point lies within the bounds of its own position.
+    for (const Point& g : randomPoints(1000))
+    {
+        Key key(quantizer, 0);
+        key.init(g);
+        for (uint64_t depth(0); depth <= Quantizer::bits; ++depth)
+        {
+            ASSERT_TRUE(within(g, key.bounds())) << g << " at " << depth;
+            key.step();
+        }
+    }
+}
+
+TEST(key, edges)
+{
+    // A point exactly on an edge between cells belongs to the upper cell, as
+    // with bisection, regardless of rounding in the scale.
+    std::mt19937 gen(42);
+    for (uint64_t depth(1); depth <= Quantizer::bits; ++depth)
+    {
+        std::uniform_int_distribution<uint64_t> dist(
+            1,
+            (uint64_t(1) << depth) - 1);
+
+        for (int i(0); i < 100; ++i)
+        {
+            const Xyz p(dist(gen), dist(gen), dist(gen));
+            const Bounds b(quantizer.bounds(p, depth));
+
+            ASSERT_EQ(positionOf(b.min(), depth), p) << p << " at " << depth;
+
+            const Point below(
+                std::nextafter(b.min().x, -infinity),
+                std::nextafter(b.min().y, -infinity),
+                std::nextafter(b.min().z, -infinity));
+            ASSERT_EQ(
+                positionOf(below, depth),
+                Xyz(p.x - 1, p.y - 1, p.z - 1)) << p << " at " << depth;
+        }
+    }
+
+    // Edges are shared exactly between neighbors and between depths.
+    const Xyz p(5, 6, 7);
+    EXPECT_EQ(
+        quantizer.bounds(p, 10).max(),
+        quantizer.bounds(Xyz(6, 7, 8), 10).min());
+    EXPECT_EQ(
+        quantizer.bounds(p, 10).min(),
+        quantizer.bounds(Xyz(10, 12, 14), 11).min());
+}
+
+TEST(key, outOfBounds)
+{
+    const uint64_t last((uint64_t(1) << Quantizer::bits) - 1);
+
+    // The maximum edge of the cube lands in its last cell.
+    EXPECT_EQ(quantizer.quantize(cube.min()), Xyz(0, 0, 0));
+    EXPECT_EQ(quantizer.quantize(cube.max()), Xyz(last, last, last));
+    EXPECT_EQ(positionOf(cube.max(), 3), Xyz(7, 7, 7));
+
+    // Points outside of the cube, including non-finite ones, are clamped.
+    EXPECT_EQ(quantizer.quantize(cube.min() - 1e9), Xyz(0, 0, 0));
+    EXPECT_EQ(
+        quantizer.quantize(cube.max() + 1e9),
+        Xyz(last, last, last));
+    EXPECT_EQ(
+        quantizer.quantize(Point(-infinity, infinity, 1e300)),
+        Xyz(0, last, last));
+    EXPECT_EQ(
+        quantizer.quantize(Point(notANumber, notANumber, notANumber)),
+        Xyz(0, 0, 0));
+
+    const double x[] { notANumber, -infinity, infinity };
+    const double y[] { 0, notANumber, 1e300 };
+    const double z[] { -1e300, 0, notANumber };
+    Xyz out[3];
+    quantizer.quantize(x, y, z, 3, out);
+    EXPECT_EQ(out[0], Xyz(0, 0, 0));
+    EXPECT_EQ(out[1], Xyz(0, 0, 0));
+    EXPECT_EQ(out[2], Xyz(last, last, 0));
+}
+
+TEST(key, deep)
+{
+    // Past the lattice resolution, every point of a cell falls into the first
+    // child of the cell above it.
+    for (const Point& g : randomPoints(100))
+    {
+        Key key(quantizer, 0);
+        key.init(g, Quantizer::bits);
+        const Xyz base(key.position());
+
+        for (uint64_t extra(1); extra <= 10; ++extra)
+        {
+            ASSERT_EQ(key.step(), Dir::swd);
+            ASSERT_EQ(key.depth(), Quantizer::bits + extra);
+            ASSERT_EQ(
+                key.position(),
+                Xyz(base.x << extra, base.y << extra, base.z << extra));
+            ASSERT_EQ(key.dirAt(key.depth() - 1), Dir::swd);
+        }
+
+        ChunkKey c(quantizer);
+        c.init(g, Quantizer::bits + 4);
+        EXPECT_EQ(c.position(), Quantizer::position(key.l, c.depth()));
+    }
+}
+
+TEST(key, steps)
+{
+    // Stepping and direct initialization at a depth agree, as do the stepped
+    // directions with the bits of the deeper position.
+    for (const Point& g : randomPoints(100))
+    {
+        Key key(quantizer, 2);
+        key.init(g);
+        EXPECT_EQ(key.depth(), 2u);
+
+        for (uint64_t depth(3); depth < 40; ++depth)
+        {
+            const Dir dir(key.step());
+            ASSERT_EQ(key.position(), positionOf(g, depth));
+            ASSERT_EQ(dir, getDirection(key.position()));
+            ASSERT_EQ(dir, key.dirAt(depth - 1));
+
+            ChunkKey c(quantizer);
+            c.init(g, depth - 1);
+            ASSERT_EQ(c.getStep(dir).position(), key.position());
+        }
+    }
+}
@@ -0,0 +1,241 @@
+#include "gtest/gtest.h"
+#include "fixture.hpp"
+
+#include <cmath>
+#include <cstring>
+#include <limits>
+#include <random>
+#include <vector>
+
+#include <entwine/types/dimension.hpp>
+#include <entwine/types/point.hpp>
+#include <entwine/types/record.hpp>
+
+using namespace entwine;
+
+namespace
+{
+    const Schema absolute {
+        { "X", Type::Double },
+        { "Y", Type::Double },
+        { "Z", Type::Double },
+        { "Intensity", Type::Unsigned16 },
+        { "GpsTime", Type::Double }
+    };
+
+    const Schema scaled {
+        { "X", Type::Signed32, 0.01, 100 },
+        { "Y", Type::Signed32, 0.01, 200 },
+        { "Z", Type::Signed32, 0.001, -50 },
+        { "Intensity", Type::Unsigned16 },
+        { "GpsTime", Type::Double }
+    };
+
+    // XYZ after other dimensions, so the unconverted ones form one run.
+    const Schema trailing {
+        { "Intensity", Type::Unsigned16 },
+        { "GpsTime", Type::Double },
+        { "X", Type::Signed32, 0.01, 100 },
+        { "Y", Type::Signed32, 0.01, 200 },
+        { "Z", Type::Signed32, 0.001, -50 }
+    };
+
+    // Random records, with XYZ in a range which every schema here can hold.
+    std::vector<char> makeRecords(const Schema& schema, const uint64_t np)
+    {
+        std::mt19937 gen(42);
+        std::uniform_real_distribution<double> dist(-1000, 1000);
+
+        const RecordXyz xyz(schema);
+        const uint64_t pointSize(getPointSize(schema));
+        std::vector<char> records(test::makeRecords(schema, np));
+        for (uint64_t i(0); i < np; ++i)
+        {
+            xyz.set(
+                records.data() + i * pointSize,
+                Point(dist(gen), dist(gen), dist(gen)));
+        }
+        return records;
+    }
+
+    // The bytes of a record other than its XYZ.
+    std::string others(const Schema& schema, const char* record)
+    {
+        std::string result;
+        uint64_t offset(0);
+        for (const Dimension& d : schema)
+        {
+            const uint64_t bytes(size(d.type));
+            if (d.name != "X" && d.name != "Y" && d.name != "Z")
+            {
+                result.append(record + offset, bytes);
+            }
+            offset += bytes;
+        }
+        return result;
+    }
+
+    void expectNear(const Point& a, const Point& b, const Point& tolerance)
+    {
+        EXPECT_NEAR(a.x, b.x, tolerance.x);
+        EXPECT_NEAR(a.y, b.y, tolerance.y);
+        EXPECT_NEAR(a.z, b.z, tolerance.z);
+    }
+}
+
+TEST(record, xyz)
+{
+    std::vector<char> record(getPointSize(scaled));
+    const RecordXyz xyz(scaled);
+    ASSERT_TRUE(xyz.scaled());
+
+    xyz.set(record.data(), Point(123.456, 200.004, -49.9996));
+    const Point p(xyz.get(record.data()));
+    EXPECT_DOUBLE_EQ(p.x, 123.46);
+    EXPECT_DOUBLE_EQ(p.y, 200.0);
+    EXPECT_DOUBLE_EQ(p.z, -50.0);
+
+    int32_t x(0);
+    std::memcpy(&x, record.data() + getOffset(scaled, "X"), sizeof(x));
+    EXPECT_EQ(x, 2346);
+
+    const RecordXyz abs(absolute);
+    EXPECT_FALSE(abs.scaled());
+    std::vector<char> other(getPointSize(absolute));
+    abs.set(other.data(), Point(1.5, -2.25, 1e10));
+    EXPECT_EQ(abs.get(other.data()), Point(1.5, -2.25, 1e10));
+
+    EXPECT_TRUE(xyz.sameAs(RecordXyz(trailing)));
+    EXPECT_FALSE(xyz.sameAs(abs));
+}
+
+TEST(record, xyzRange)
+{
+    std::vector<char> record(getPointSize(scaled));
+    const RecordXyz xyz(scaled);
+
+    // The extremes of a 32-bit integer at this scale and offset fit.
+    const double max(100 + std::numeric_limits<int32_t>::max() * 0.01);
+    const double min(100 + std::numeric_limits<int32_t>::min() * 0.01);
+    EXPECT_NO_THROW(xyz.set(record.data(), Point(max, 200, 0)));
+    EXPECT_NO_THROW(xyz.set(record.data(), Point(min, 200, 0)));
+
+    // Anything past them would wrap, so it throws instead.
+    EXPECT_ANY_THROW(xyz.set(record.data(), Point(max + 1, 200, 0)));
+    EXPECT_ANY_THROW(xyz.set(record.data(), Point(min - 1, 200, 0)));
+    EXPECT_ANY_THROW(xyz.set(record.data(), Point(100, 1e12, 0)));
+    EXPECT_ANY_THROW(xyz.set(record.data(), Point(100, 200, -1e7)));
+
+    const double nan(std::numeric_limits<double>::quiet_NaN());
+    const double inf(std::numeric_limits<double>::infinity());
+    EXPECT_ANY_THROW(xyz.set(record.data(), Point(nan, 200, 0)));
+    EXPECT_ANY_THROW(xyz.set(record.data(), Point(100, inf, 0)));
+}
+
+TEST(record, identity)
+{
+    for (const Schema& schema : { absolute, scaled, trailing })
+    {
+        const RecordConverter converter(schema, schema);
+        EXPECT_TRUE(converter.identity());
+
+        const std::vector<char> src(makeRecords(schema, 100));
+        std::vector<char> dst(src.size());
+        converter.convert(src.data(), dst.data(), 100);
+        EXPECT_EQ(dst, src);
+    }
+}
+
+TEST(record, convert)
+{
+    const uint64_t np(100);
+
+    for (const Schema& schema : { scaled, trailing })
+    {
+        const Schema abs(makeAbsolute(schema));
+        const RecordConverter toAbsolute(schema, abs);
+        const RecordConverter toScaled(abs, schema);
+        EXPECT_FALSE(toAbsolute.identity());
+        EXPECT_EQ(toAbsolute.fromPointSize(), getPointSize(schema));
+        EXPECT_EQ(toAbsolute.toPointSize(), getPointSize(abs));
+
+        const std::vector<char> src(makeRecords(schema, np));
+        std::vector<char> mid(np * getPointSize(abs));
+        std::vector<char> dst(src.size());
+        toAbsolute.convert(src.data(), mid.data(), np);
+        toScaled.convert(mid.data(), dst.data(), np);
+
+        // Values on the scaled grid survive the round trip exactly.
+        EXPECT_EQ(dst, src);
+
+        const RecordXyz from(schema);
+        const RecordXyz to(abs);
+        for (uint64_t i(0); i < np; ++i)
+        {
+            const char* a(src.data() + i * getPointSize(schema));
+            const char* b(mid.data() + i * getPointSize(abs));
+            expectNear(to.get(b), from.get(a), Point(1e-9, 1e-9, 1e-9));
+            ASSERT_EQ(others(abs, b), others(schema, a));
+        }
+    }
+
+    // Between differing scales, values are rounded to the coarser one.  Our
+    // values are on a finer grid, so some sit exactly halfway.
+    Schema coarse(scaled);
+    for (Dimension& d : coarse) if (d.type == Type::Signed32) d.scale = 0.1;
+
+    const std::vector<char> src(makeRecords(scaled, np));
+    std::vector<char> dst(np * getPointSize(coarse));
+    RecordConverter(scaled, coarse).convert(src.data(), dst.data(), np);
+
+    const RecordXyz from(scaled);
+    const RecordXyz to(coarse);
+    for (uint64_t i(0); i < np; ++i)
+    {
+        const char* a(src.data() + i * getPointSize(scaled));
+        const char* b(dst.data() + i * getPointSize(coarse));
+        const double half(0.05 + 1e-9);
+        expectNear(to.get(b), from.get(a), Point(half, half, half));
+    }
+}
+
+TEST(record, invalid)
+{
+    EXPECT_ANY_THROW(RecordConverter(scaled, omit(scaled, "GpsTime")));
+    EXPECT_ANY_THROW(RecordConverter(scaled, trailing));
+
+    Schema mismatched(scaled);
+    find(mismatched, "Intensity").type = Type::Unsigned32;
+    EXPECT_ANY_THROW(RecordConverter(scaled, mismatched));
+
+    Schema mixed(absolute);
+    find(mixed, "Z").type = Type::Signed32;
+    EXPECT_ANY_THROW(RecordXyz xyz(mixed));
+
+    Schema wide(absolute);
+    for (Dimension& d : wide) if (d.type == Type::Double) d.type = Type::Float;
+    EXPECT_ANY_THROW(RecordXyz xyz(wide));
+}
+
+TEST(record, memorySchema)
+{
+    // Scaled XYZ stay scaled in memory, so converting is a copy.
+    EXPECT_EQ(getPointSize(makeInMemory(scaled)), getPointSize(scaled));
+    EXPECT_TRUE(RecordXyz(makeInMemory(scaled)).scaled());
+    EXPECT_TRUE(RecordConverter(scaled, makeInMemory(scaled)).identity());
+
+    // Unscaled integral XYZ are held as doubles.
+    Schema unscaled(scaled);
+    for (const std::string name : { "X", "Y", "Z" })
+    {
+        find(unscaled, name).scale = 1;
+        find(unscaled, name).offset = 0;
+    }
+    const Schema memory(makeInMemory(unscaled));
+    EXPECT_FALSE(RecordXyz(memory).scaled());
+    EXPECT_TRUE(find(memory, "X").type == Type::Double);
+    EXPECT_FALSE(RecordConverter(unscaled, memory).identity());
+
+    EXPECT_FALSE(RecordXyz(makeInMemory(absolute)).scaled());
+    EXPECT_TRUE(RecordConverter(absolute, makeInMemory(absolute)).identity());
+}
@@ -0,0 +1,136 @@
+#include "gtest/gtest.h"
+
+#include <cstdint>
+#include <cstdlib>
+#include <set>
+#include <vector>
+
+#include <entwine/builder/schedule.hpp>
+
+using namespace entwine;
+
+namespace
+{
+    const Bounds bounds(0, 0, 0, 4, 4, 4);
+
+    BuildItem makeItem(const Bounds& b, const uint64_t points)
+    {
+        Source source("source-" + std::to_string(points));
+        source.info.bounds = b;
+        source.info.points = points;
+        return BuildItem(source);
+    }
+
+    // Sources tiling our bounds in a grid of unit cells, listed by row.
+    Manifest makeGrid()
+    {
+        Manifest manifest;
+        for (int y(0); y < 4; ++y)
+        {
+            for (int x(0); x < 4; ++x)
+            {
+                manifest.push_back(
+                    makeItem(Bounds(x, y, 0, x + 1, y + 1, 4), 100));
+            }
+        }
+        return manifest;
+    }
+
+    OriginList makeOrigins(const Manifest& manifest)
+    {
+        OriginList origins;
+        for (Origin o(0); o < manifest.size(); ++o) origins.push_back(o);
+        return origins;
+    }
+
+    OriginList scheduled(Schedule s, const Manifest& manifest)
+    {
+        OriginList origins(makeOrigins(manifest));
+        schedule::apply(s, manifest, bounds, origins);
+        return origins;
+    }
+}
+
+TEST(schedule, strings)
+{
+    for (const Schedule s :
+        { Schedule::Manifest, Schedule::Hilbert, Schedule::Largest })
+    {
+        EXPECT_TRUE(toSchedule(toString(s)) == s);
+
+        json j;
+        to_json(j, s);
+        Schedule parsed(Schedule::Manifest);
+        from_json(j, parsed);
+        EXPECT_TRUE(parsed == s);
+    }
+
+    EXPECT_ANY_THROW(toSchedule("random"));
+    EXPECT_ANY_THROW(toSchedule(""));
+}
+
+TEST(schedule, manifest)
+{
+    const Manifest manifest(makeGrid());
+    EXPECT_EQ(scheduled(Schedule::Manifest, manifest), makeOrigins(manifest));
+}
+
+TEST(schedule, largest)
+{
+    Manifest manifest;
+    for (const uint64_t points : { 5, 20, 10, 20, 0, 10 })
+    {
+        manifest.push_back(makeItem(bounds, points));
+    }
+
+    // Ties keep their manifest order.
+    EXPECT_EQ(
+        scheduled(Schedule::Largest, manifest),
+        OriginList({ 1, 3, 2, 5, 0, 4 }));
+}
+
+TEST(schedule, hilbert)
+{
+    const Manifest manifest(makeGrid());
+    const OriginList origins(scheduled(Schedule::Hilbert, manifest));
+
+    // Every source is visited once, starting from the minimum corner, and each
+    // one is a neighbor of the one before it.
+    ASSERT_EQ(origins.size(), manifest.size());
+    EXPECT_EQ(std::set<Origin>(origins.begin(), origins.end()).size(), 16u);
+    EXPECT_EQ(origins.front(), 0u);
+
+    for (std::size_t i(1); i < origins.size(); ++i)
+    {
+        const int a(origins[i - 1]);
+        const int b(origins[i]);
+        EXPECT_EQ(std::abs(a % 4 - b % 4) + std::abs(a / 4 - b / 4), 1) <<
+            a << " to " << b;
+    }
+}
+
+TEST(schedule, hilbertTies)
+{
+    // Sources with the same center keep their manifest order.  Empty bounds
+    // sit at the minimum corner, so they are scheduled first.
+    Manifest manifest(makeGrid());
+    manifest.push_back(makeItem(Bounds(3, 3, 0, 4, 4, 4), 1));
+    manifest.push_back(makeItem(Bounds(0, 0, 0, 1, 1, 4), 2));
+    manifest.push_back(makeItem(Bounds(), 3));
+
+    const OriginList origins(scheduled(Schedule::Hilbert, manifest));
+    ASSERT_EQ(origins.size(), manifest.size());
+
+    auto position([&origins](Origin o)
+    {
+        for (std::size_t i(0); i < origins.size(); ++i)
+        {
+            if (origins[i] == o) return i;
+        }
+        return origins.size();
+    });
+
+    EXPECT_EQ(position(17) - position(0), 1u);
+    EXPECT_EQ(position(16) - position(15), 1u);
+    EXPECT_EQ(position(18), 0u);
+}
@@ -0,0 +1,164 @@
+#include "gtest/gtest.h"
+#include "fixture.hpp"
+
+#include <cstring>
+#include <random>
+#include <set>
+#include <string>
+#include <vector>
+
+#include <entwine/io/shuffle.hpp>
+
+using namespace entwine;
+
+namespace
+{
+    std::vector<char> roundTrip(const Schema& schema, std::vector<char> rows)
+    {
+        const uint64_t np(rows.size() / getPointSize(schema));
+        const std::vector<char> shuffled(io::shuffle::encode(schema, rows));
+        EXPECT_EQ(shuffled.size(), rows.size());
+
+        std::vector<char> result(rows.size());
+        io::shuffle::decode(schema, shuffled.data(), result.data(), np);
+        return result;
+    }
+
+    std::multiset<std::string> toRecords(
+        const Schema& schema,
+        const std::vector<char>& rows)
+    {
+        const uint64_t pointSize(getPointSize(schema));
+        std::multiset<std::string> records;
+        for (uint64_t i(0); i < rows.size(); i += pointSize)
+        {
+            records.emplace(rows.data() + i, pointSize);
+        }
+        return records;
+    }
+
+    const std::vector<Type> types {
+        Type::Unsigned8,
+        Type::Signed16,
+        Type::Unsigned32,
+        Type::Signed64
+    };
+}
+
+TEST(shuffle, widths)
+{
+    // Without GpsTime, the point order is preserved.  X is delta coded while
+    // the other dimension is not.
+    for (const Type type : types)
+    {
+        const Schema schema { { "X", type }, { "Intensity", type } };
+        const std::vector<char> rows(test::makeRecords(schema, 1000));
+        EXPECT_EQ(roundTrip(schema, rows), rows) << typeString(type);
+    }
+}
+
+TEST(shuffle, mixed)
+{
+    const Schema schema {
+        { "X", Type::Signed32 },
+        { "Y", Type::Signed32 },
+        { "Z", Type::Signed32 },
+        { "Intensity", Type::Unsigned16 },
+        { "Classification", Type::Unsigned8 },
+        { "Other", Type::Unsigned64 }
+    };
+    const std::vector<char> rows(test::makeRecords(schema, 1000));
+    EXPECT_EQ(roundTrip(schema, rows), rows);
+}
+
+TEST(shuffle, doubles)
+{
+    const Schema schema {
+        { "X", Type::Double },
+        { "Y", Type::Double },
+        { "Z", Type::Double },
+        { "GpsTime", Type::Double },
+        { "Intensity", Type::Unsigned16 }
+    };
+    const uint64_t pointSize(getPointSize(schema));
+    const uint64_t timeOffset(getOffset(schema, "GpsTime"));
+    const uint64_t np(1000);
+
+    std::mt19937 gen(42);
+    std::uniform_real_distribution<double> dist(-1e6, 1e6);
+    std::vector<char> rows(test::makeRecords(schema, np));
+    for (uint64_t i(0); i < np; ++i)
+    {
+        for (uint64_t offset(0); offset < timeOffset + 8; offset += 8)
+        {
+            const double v(dist(gen));
+            std::memcpy(rows.data() + i * pointSize + offset, &v, 8);
+        }
+    }
+
+    // Points are reordered by GpsTime, but their records are intact.
+    const std::vector<char> result(roundTrip(schema, rows));
+    EXPECT_EQ(toRecords(schema, result), toRecords(schema, rows));
+
+    double prev(-1e9);
+    for (uint64_t i(0); i < np; ++i)
+    {
+        double time(0);
+        std::memcpy(&time, result.data() + i * pointSize + timeOffset, 8);
+        ASSERT_LE(prev, time) << "At: " << i;
+        prev = time;
+    }
+}
+
+TEST(shuffle, sizes)
+{
+    const Schema schema {
+        { "X", Type::Signed32 },
+        { "GpsTime", Type::Double },
+        { "Intensity", Type::Unsigned16 }
+    };
+
+    const std::vector<char> empty;
+    EXPECT_TRUE(io::shuffle::encode(schema, empty).empty());
+    EXPECT_TRUE(roundTrip(schema, empty).empty());
+
+    const std::vector<char> single(test::makeRecords(schema, 1));
+    EXPECT_EQ(roundTrip(schema, single), single);
+}
+
+TEST(shuffle, columns)
+{
+    // Each dimension occupies a contiguous block of the shuffled output, so a
+    // single column may be decoded on its own.
+    const Schema schema {
+        { "X", Type::Signed32 },
+        { "Intensity", Type::Unsigned16 },
+        { "Other", Type::Unsigned64 }
+    };
+    const uint64_t pointSize(getPointSize(schema));
+    const uint64_t np(100);
+    const std::vector<char> rows(test::makeRecords(schema, np));
+    const std::vector<char> shuffled(io::shuffle::encode(schema, rows));
+
+    const char* pos(shuffled.data());
+    uint64_t offset(0);
+    for (const Dimension& d : schema)
+    {
+        const uint64_t bytes(size(d.type));
+        std::vector<char> column(np * bytes);
+        io::shuffle::decode({ d }, pos, column.data(), np);
+
+        for (uint64_t i(0); i < np; ++i)
+        {
+            ASSERT_EQ(
+                std::memcmp(
+                    column.data() + i * bytes,
+                    rows.data() + i * pointSize + offset,
+                    bytes),
+                0) << d.name << " at " << i;
+        }
+
+        pos += np * bytes;
+        offset += bytes;
+    }
+}
@@ -0,0 +1,105 @@
+#include "gtest/gtest.h"
+
+#include <cstdint>
+#include <cstring>
+#include <set>
+#include <thread>
+#include <vector>
+
+#include <entwine/util/slab-pool.hpp>
+
+using namespace entwine;
+
+namespace
+{
+    SlabPool& pool(SlabPool::get());
+
+    const uint64_t mb(1024 * 1024);
+}
+
+TEST(slabPool, reuse)
+{
+    ASSERT_TRUE(pool.trim());
+
+    // Sizes are padded, so slabs of similar sizes share a free list.
+    char* a(pool.acquire(1000));
+    char* b(pool.acquire(1000));
+    EXPECT_NE(a, b);
+    EXPECT_EQ(reinterpret_cast<uintptr_t>(a) % 64, 0u);
+    EXPECT_EQ(reinterpret_cast<uintptr_t>(b) % 64, 0u);
+    std::memset(a, 1, 1000);
+    std::memset(b, 2, 1000);
+
+    EXPECT_EQ(pool.info().outstanding, 2048u);
+    EXPECT_EQ(pool.info().free, 0u);
+
+    pool.release(a, 1000);
+    EXPECT_EQ(pool.info().outstanding, 1024u);
+    EXPECT_EQ(pool.info().free, 1024u);
+    EXPECT_EQ(pool.acquire(1020), a);
+
+    pool.release(a, 1020);
+    pool.release(b, 1000);
+    EXPECT_EQ(pool.info().outstanding, 0u);
+}
+
+TEST(slabPool, arenas)
+{
+    ASSERT_TRUE(pool.trim());
+
+    // Small slabs share an arena, and oversized ones get their own.
+    std::vector<char*> small;
+    for (int i(0); i < 100; ++i) small.push_back(pool.acquire(mb));
+    EXPECT_EQ(std::set<char*>(small.begin(), small.end()).size(), 100u);
+    const uint64_t reserved(pool.info().reserved);
+    EXPECT_GE(reserved, 100 * mb);
+
+    char* large(pool.acquire(100 * mb));
+    std::memset(large, 1, 100 * mb);
+    EXPECT_GE(pool.info().reserved, reserved + 100 * mb);
+
+    // Nothing is freed while any slab is outstanding.
+    for (char* slab : small) pool.release(slab, mb);
+    EXPECT_FALSE(pool.trim());
+    EXPECT_GE(pool.info().reserved, reserved + 100 * mb);
+
+    pool.release(large, 100 * mb);
+    EXPECT_TRUE(pool.trim());
+    EXPECT_EQ(pool.info().reserved, 0u);
+    EXPECT_EQ(pool.info().free, 0u);
+
+    // The pool is usable again afterward.
+    char* slab(pool.acquire(mb));
+    std::memset(slab, 1, mb);
+    EXPECT_EQ(pool.info().reserved, 64 * mb);
+    pool.release(slab, mb);
+}
+
+TEST(slabPool, threads)
+{
+    ASSERT_TRUE(pool.trim());
+
+    // Slabs released by one thread, including those left in its cache when
+    // it exits, may be acquired by another.
+    std::vector<char*> slabs;
+    std::thread t([&slabs]()
+    {
+        for (int i(0); i < 20; ++i) slabs.push_back(pool.acquire(mb));
+        for (char* slab : slabs) pool.release(slab, mb);
+    });
+    t.join();
+
+    const uint64_t reserved(pool.info().reserved);
+    std::set<char*> reused;
+    for (int i(0); i < 20; ++i) reused.insert(pool.acquire(mb));
+    EXPECT_EQ(reused, std::set<char*>(slabs.begin(), slabs.end()));
+    EXPECT_EQ(pool.info().reserved, reserved);
+    for (char* slab : reused) pool.release(slab, mb);
+
+    // Slabs cached by this thread before a trim are not handed out after it.
+    ASSERT_TRUE(pool.trim());
+    char* fresh(pool.acquire(mb));
+    std::memset(fresh, 1, mb);
+    EXPECT_EQ(pool.info().outstanding, mb);
+    pool.release(fresh, mb);
+}
@@ -0,0 +1,114 @@
+#include "gtest/gtest.h"
+#include "config.hpp"
+#include "fixture.hpp"
+
+#include <string>
+#include <vector>
+
+#include <entwine/builder/spill-store.hpp>
+#include <entwine/util/io.hpp>
+#include <entwine/util/pool.hpp>
+
+using namespace entwine;
+
+namespace
+{
+    const std::string outPath(test::dataPath() + "out/spill/");
+    const std::string tmpPath(test::dataPath() + "out/spill-tmp/");
+
+    const Schema schema {
+        { "X", Type::Double },
+        { "Y", Type::Double },
+        { "Z", Type::Double },
+        { "Intensity", Type::Unsigned16 }
+    };
+
+    const Dxyz a(3, 1, 2, 3);
+    const Dxyz b(3, 4, 5, 6);
+}
+
+TEST(spill, raw)
+{
+    const Metadata metadata(test::makeMetadata(schema));
+    const Endpoints endpoints(test::makeEndpoints(outPath, tmpPath));
+    SpillStore store(endpoints, metadata, 1 << 20);
+
+    const std::vector<char> records(test::makeRecords(schema, 100, 1));
+    store.put(a, records);
+
+    std::vector<char> taken;
+    EXPECT_FALSE(store.take(b, taken));
+    ASSERT_TRUE(store.take(a, taken));
+    EXPECT_EQ(taken, records);
+
+    // Once taken, an entry is gone.
+    EXPECT_FALSE(store.take(a, taken));
+}
+
+TEST(spill, tiers)
+{
+    const Metadata metadata(test::makeMetadata(schema));
+    const Endpoints endpoints(test::makeEndpoints(outPath, tmpPath));
+
+    // With no memory budget, settled entries go to scratch space, and are
+    // removed from it when taken.
+    for (const uint64_t budget : { uint64_t(1 << 20), uint64_t(0) })
+    {
+        SpillStore store(endpoints, metadata, budget);
+
+        const std::vector<char> ra(test::makeRecords(schema, 1000, 1));
+        const std::vector<char> rb(test::makeRecords(schema, 10, 2));
+        store.put(a, ra);
+        store.put(b, rb);
+        store.settle(a);
+        store.settle(b);
+
+        const std::string scratch("spill-" + a.toString() + "-0.zst");
+        EXPECT_EQ(!!endpoints.tmp.tryGetSize(scratch), !budget) << budget;
+
+        std::vector<char> taken;
+        ASSERT_TRUE(store.take(a, taken));
+        EXPECT_EQ(taken, ra);
+        EXPECT_FALSE(endpoints.tmp.tryGetSize(scratch));
+
+        // Spilled again, after being taken.
+        store.put(a, ra);
+        store.settle(a);
+        ASSERT_TRUE(store.take(a, taken));
+        EXPECT_EQ(taken, ra);
+
+        ASSERT_TRUE(store.take(b, taken));
+        EXPECT_EQ(taken, rb);
+    }
+}
+
+TEST(spill, flush)
+{
+    const Metadata metadata(test::makeMetadata(schema));
+    const Endpoints endpoints(test::makeEndpoints(outPath, tmpPath));
+
+    const std::vector<char> ra(test::makeRecords(schema, 1000, 1));
+    const std::vector<char> rb(test::makeRecords(schema, 10, 2));
+    {
+        SpillStore store(endpoints, metadata, 0);
+        store.put(a, ra);
+        store.settle(a);
+
+        // Settled after finishing, this one stays raw.
+        store.finish();
+        store.put(b, rb);
+        store.settle(b);
+
+        Pool pool(2);
+        store.flush(pool);
+
+        std::vector<char> taken;
+        EXPECT_FALSE(store.take(a, taken));
+        EXPECT_FALSE(store.take(b, taken));
+    }
+
+    // Each chunk is written once, to the output, in its final data type.
+    EXPECT_EQ(ensureGetBinary(endpoints.data, a.toString() + ".bin"), ra);
+    EXPECT_EQ(ensureGetBinary(endpoints.data, b.toString() + ".bin"), rb);
+    EXPECT_FALSE(endpoints.tmp.tryGetSize("spill-" + a.toString() + "-0.zst"));
+}
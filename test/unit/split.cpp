@@ -0,0 +1,124 @@
+#include "gtest/gtest.h"
+#include "config.hpp"
+
+#include <atomic>
+#include <set>
+#include <string>
+#include <vector>
+
+#include <pdal/pdal_features.hpp>
+
+#include <entwine/builder/builder.hpp>
+#include <entwine/builder/chunk-cache.hpp>
+#include <entwine/builder/clipper.hpp>
+#include <entwine/util/config.hpp>
+#include <entwine/util/info.hpp>
+#include <entwine/util/io.hpp>
+#include <entwine/util/pipeline-template.hpp>
+
+using namespace entwine;
+
+namespace
+{
+    const std::string input(test::dataPath() + "ellipsoid.laz");
+
+    const Schema schema {
+        { "X", Type::Signed32, 0.01 },
+        { "Y", Type::Signed32, 0.01 },
+        { "Z", Type::Signed32, 0.01 },
+        { "OriginId", Type::Unsigned32 },
+        { "PointId", Type::Unsigned64 }
+    };
+
+    // Insert our input in the given number of point ranges, and return every
+    // resulting record.  Records are compared regardless of the nodes in which
+    // they landed.
+    std::multiset<std::string> build(const uint64_t slices)
+    {
+        const std::string outPath(
+            test::dataPath() + "out/split-" + std::to_string(slices) + "/");
+
+        const json j {
+            { "output", outPath },
+            { "force", true },
+            { "dataType", "binary" },
+            { "schema", schema }
+        };
+
+        const SourceList sources(analyze({ input }));
+        const Metadata metadata(
+            config::getMetadata(
+                merge(json(manifest::reduce(sources)), j)));
+        const Manifest manifest(sources.begin(), sources.end());
+
+        Builder builder(config::getEndpoints(j), metadata, manifest);
+
+        const auto pipeline(
+            std::make_shared<const PipelineTemplate>(
+                toTemplate(json::array({ json::object() }), input)));
+        SplitSource source(0, slices, pipeline);
+
+        const uint64_t points(manifest.at(0).source.info.points);
+        const uint64_t perSlice(points / slices);
+        std::atomic_uint64_t counter(0);
+
+        {
+            ChunkCache cache(
+                builder.endpoints,
+                builder.metadata,
+                builder.hierarchy,
+                4);
+            {
+                Clipper clipper(cache);
+                for (uint64_t i(0); i < slices; ++i)
+                {
+                    const uint64_t start(i * perSlice);
+                    const uint64_t count(i + 1 < slices ? perSlice : 0);
+                    builder.insert(
+                        cache,
+                        clipper,
+                        source,
+                        start,
+                        count,
+                        counter);
+                }
+            }
+            cache.join();
+        }
+
+        EXPECT_EQ(counter.load(), points);
+
+        const uint64_t pointSize(getPointSize(builder.metadata.schema));
+        std::multiset<std::string> records;
+        for (const auto& p : builder.hierarchy.map)
+        {
+            if (!p.second) continue;
+
+            const std::vector<char> data(
+                ensureGetBinary(
+                    builder.endpoints.data,
+                    p.first.toString() + ".bin"));
+            EXPECT_EQ(data.size(), p.second * pointSize);
+
+            for (uint64_t i(0); i < data.size(); i += pointSize)
+            {
+                records.emplace(data.data() + i, pointSize);
+            }
+        }
+
+        EXPECT_EQ(records.size(), points);
+        return records;
+    }
+}
+
+TEST(split, matchesUnsplit)
+{
+#if PDAL_VERSION_MAJOR < 2 || \
+    (PDAL_VERSION_MAJOR == 2 && PDAL_VERSION_MINOR < 3)
+    GTEST_SKIP() << "This PDAL version cannot seek within LAS files";
+#endif
+
+    // Every point, including its PointId, must be the same whether or not its
+    // source was split.
+    EXPECT_EQ(build(4), build(1));
+}
@@ -0,0 +1,208 @@
+#include "gtest/gtest.h"
+
+#include <cstdint>
+#include <map>
+#include <set>
+#include <vector>
+
+#include <entwine/builder/voxel-grid.hpp>
+
+using namespace entwine;
+
+namespace
+{
+    const uint64_t span(128);
+
+    // Residents of a tube, by Z position, with their squared distances from
+    // their voxel centers.
+    using Residents = std::map<uint32_t, double>;
+
+    // Record storage for a tube, whose contents are only compared by address.
+    std::vector<char> storage(span * 4);
+
+    void fill(VoxelTube& tube, const Residents& residents)
+    {
+        for (const auto& r : residents) tube.at(r.first) = &storage[r.first];
+    }
+
+    void update(
+        RejectionSummary& summary,
+        uint64_t i,
+        const VoxelTube& tube,
+        const Residents& residents)
+    {
+        summary.update(i, tube, [&](uint32_t z, const char* data)
+        {
+            EXPECT_EQ(data, &storage[z]);
+            return residents.at(z);
+        });
+    }
+}
+
+TEST(voxelTube, at)
+{
+    VoxelTube tube;
+    EXPECT_EQ(tube.size(), 0u);
+    EXPECT_EQ(tube.bytes(), 0u);
+
+    // Positions collide in the table, both within and beyond a chunk's span,
+    // and the table grows well past its initial size.
+    std::vector<uint32_t> zs;
+    for (uint32_t z(0); z < 100; ++z) zs.push_back(z * 37 % 101 + span * 3);
+
+    for (const uint32_t z : zs)
+    {
+        char*& slot(tube.at(z));
+        ASSERT_EQ(slot, nullptr) << z;
+        slot = &storage[z];
+    }
+    EXPECT_EQ(tube.size(), zs.size());
+
+    // Existing slots are found again, without being added twice.
+    for (const uint32_t z : zs)
+    {
+        ASSERT_EQ(tube.at(z), &storage[z]) << z;
+    }
+    EXPECT_EQ(tube.size(), zs.size());
+
+    std::map<uint32_t, const char*> seen;
+    tube.each([&](uint32_t z, const char* data)
+    {
+        EXPECT_TRUE(seen.emplace(z, data).second) << z;
+    });
+    ASSERT_EQ(seen.size(), zs.size());
+    for (const uint32_t z : zs) EXPECT_EQ(seen[z], &storage[z]);
+
+    // Cells are 16 bytes, and at most three quarters full.
+    EXPECT_GE(tube.bytes(), tube.size() * 16 * 4 / 3);
+}
+
+TEST(voxelGrid, sparse)
+{
+    VoxelGrid grid(span);
+    const uint64_t empty(grid.bytes());
+
+    // Nothing is allocated for positions without points.
+    for (uint64_t i(0); i < span * span; i += 61)
+    {
+        EXPECT_EQ(VoxelGrid::find(grid.block(i), i), nullptr);
+    }
+    EXPECT_EQ(grid.bytes(), empty);
+
+    // Tubes are created out of order within a block, and each keeps its own
+    // contents as its neighbors are inserted around it.
+    const std::vector<uint64_t> positions { 70, 127, 64, 100, 65, 0, 63 };
+    for (const uint64_t i : positions)
+    {
+        VoxelTube& tube(VoxelGrid::tube(grid.block(i), i));
+        EXPECT_EQ(tube.size(), 0u) << i;
+        tube.at(uint32_t(i)) = &storage[i];
+    }
+
+    for (const uint64_t i : positions)
+    {
+        const VoxelTube* tube(VoxelGrid::find(grid.block(i), i));
+        ASSERT_TRUE(tube) << i;
+        ASSERT_EQ(tube->size(), 1u) << i;
+        tube->each([i](uint32_t z, const char* data)
+        {
+            EXPECT_EQ(z, i);
+            EXPECT_EQ(data, &storage[i]);
+        });
+
+        // Getting an existing tube returns it, rather than a new one.
+        EXPECT_EQ(&VoxelGrid::tube(grid.block(i), i), tube);
+    }
+    EXPECT_EQ(VoxelGrid::find(grid.block(66), 66), nullptr);
+    EXPECT_EQ(VoxelGrid::find(grid.block(128), 128), nullptr);
+
+    std::set<const char*> records;
+    grid.each([&records](const char* data) { records.insert(data); });
+    EXPECT_EQ(records.size(), positions.size());
+
+    EXPECT_GT(grid.bytes(), empty);
+}
+
+TEST(rejectionSummary, open)
+{
+    // Nothing is rejected before a tube has been summarized.
+    const RejectionSummary summary(span);
+    for (uint64_t i(0); i < span * span; i += 97)
+    {
+        for (uint32_t z(0); z < span; z += 7)
+        {
+            EXPECT_FALSE(summary.rejects(i, z, 1e300));
+        }
+    }
+}
+
+TEST(rejectionSummary, rejects)
+{
+    RejectionSummary summary(span);
+    VoxelTube tube;
+    const Residents residents { { 4, 0.5 }, { 5, 2.0 }, { 6, 1.0 } };
+    fill(tube, residents);
+    update(summary, 10, tube, residents);
+
+    // Within the occupied range, points at least as far from their centers as
+    // the farthest resident are rejected.
+    for (uint32_t z(4); z <= 6; ++z)
+    {
+        EXPECT_TRUE(summary.rejects(10, z, 2.0));
+        EXPECT_TRUE(summary.rejects(10, z, 5.0));
+        EXPECT_FALSE(summary.rejects(10, z, 1.9));
+        EXPECT_FALSE(summary.rejects(10, z, 0));
+    }
+
+    // Outside of it, a point would fill an empty voxel.
+    EXPECT_FALSE(summary.rejects(10, 3, 5.0));
+    EXPECT_FALSE(summary.rejects(10, 7, 5.0));
+
+    // Z positions are local to the chunk.
+    EXPECT_TRUE(summary.rejects(10, span * 3 + 5, 5.0));
+    EXPECT_FALSE(summary.rejects(10, span * 3 + 7, 5.0));
+
+    // Other tubes are unaffected.
+    EXPECT_FALSE(summary.rejects(11, 5, 5.0));
+}
+
+TEST(rejectionSummary, gaps)
+{
+    // A tube with an empty voxel inside of its range rejects nothing.
+    RejectionSummary summary(span);
+    VoxelTube tube;
+    const Residents residents { { 4, 0.5 }, { 6, 0.5 } };
+    fill(tube, residents);
+    update(summary, 0, tube, residents);
+
+    for (uint32_t z(0); z < 10; ++z)
+    {
+        EXPECT_FALSE(summary.rejects(0, z, 1e300));
+    }
+
+    // Once the gap is filled, the tube is summarized again.
+    const Residents filled { { 4, 0.5 }, { 5, 0.5 }, { 6, 0.5 } };
+    fill(tube, filled);
+    update(summary, 0, tube, filled);
+    EXPECT_TRUE(summary.rejects(0, 5, 1.0));
+
+    // An empty tube also rejects nothing.
+    update(summary, 0, VoxelTube(), Residents());
+    EXPECT_FALSE(summary.rejects(0, 5, 1e300));
+}
+
+TEST(rejectionSummary, rounding)
+{
+    // Distances are held as floats, rounded up so that they remain an upper
+    // bound.  A point exactly as far as the farthest resident then takes the
+    // locked path, which is always safe.
+    RejectionSummary summary(span);
+    VoxelTube tube;
+    const double d(1.0 / 3.0);
+    const Residents residents { { 0, d } };
+    fill(tube, residents);
+    update(summary, 0, tube, residents);
+
+    EXPECT_FALSE(summary.rejects(0, 0, d));
+    EXPECT_TRUE(summary.rejects(0, 0, d + 1e-7));
+}
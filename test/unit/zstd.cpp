@@ -0,0 +1,138 @@
+#include "gtest/gtest.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <random>
+#include <vector>
+
+#include <entwine/util/zstd.hpp>
+
+using namespace entwine;
+
+namespace
+{
+    // Small nodes of similar records: some bytes shared by every record, some
+    // drawn from a few common values, and some noise.
+    std::vector<char> makeNode(std::mt19937& gen, const std::size_t records)
+    {
+        std::uniform_int_distribution<int> common(0, 3);
+        std::vector<char> node;
+        for (std::size_t i(0); i < records; ++i)
+        {
+            const char header[] = "entwine-record:";
+            node.insert(node.end(), header, header + sizeof(header));
+
+            const uint32_t classification(common(gen) * 1000);
+            const char* c(reinterpret_cast<const char*>(&classification));
+            node.insert(node.end(), c, c + sizeof(classification));
+
+            node.push_back(static_cast<char>(gen()));
+            node.push_back(static_cast<char>(gen()));
+        }
+        return node;
+    }
+
+    struct Samples
+    {
+        std::vector<char> data;
+        std::vector<std::size_t> sizes;
+    };
+
+    Samples makeSamples(const std::size_t count, const int seed)
+    {
+        std::mt19937 gen(seed);
+        Samples samples;
+        for (std::size_t i(0); i < count; ++i)
+        {
+            const std::vector<char> node(makeNode(gen, 20));
+            samples.data.insert(samples.data.end(), node.begin(), node.end());
+            samples.sizes.push_back(node.size());
+        }
+        return samples;
+    }
+
+    const std::size_t capacity(4096);
+}
+
+TEST(zstd, roundTrip)
+{
+    std::mt19937 gen(1);
+    const std::vector<char> data(makeNode(gen, 10000));
+
+    for (const zstd::Options& options :
+        { zstd::Options(), zstd::Options(19), zstd::Options(3, true, 2) })
+    {
+        const std::vector<char> compressed(
+            zstd::compress(data.data(), data.size(), options));
+        EXPECT_LT(compressed.size(), data.size());
+        EXPECT_EQ(zstd::dictionaryId(compressed.data(), compressed.size()), 0u);
+        EXPECT_EQ(zstd::decompress(compressed, data.size()), data);
+
+        // The size must be exactly right.
+        EXPECT_ANY_THROW(zstd::decompress(compressed, data.size() + 1));
+    }
+
+    // A frame may also be streamed in pieces.
+    zstd::Compressor compressor((zstd::Options()));
+    for (std::size_t i(0); i < data.size(); i += 1000)
+    {
+        const std::size_t size(std::min<std::size_t>(1000, data.size() - i));
+        compressor.add(data.data() + i, size);
+    }
+    EXPECT_EQ(zstd::decompress(compressor.done(), data.size()), data);
+}
+
+TEST(zstd, dictionary)
+{
+    const Samples samples(makeSamples(500, 1));
+    std::vector<char> trained(
+        zstd::Dictionary::train(samples.data, samples.sizes, capacity));
+    ASSERT_FALSE(trained.empty());
+    EXPECT_LE(trained.size(), capacity);
+
+    const zstd::Dictionary dictionary(trained, 3);
+    EXPECT_EQ(dictionary.data(), trained);
+
+    zstd::Options options;
+    options.dictionary = &dictionary;
+
+    // Nodes the dictionary hasn't seen compress better with it than without.
+    std::mt19937 gen(2);
+    std::size_t plainBytes(0);
+    std::size_t dictionaryBytes(0);
+    for (int i(0); i < 20; ++i)
+    {
+        const std::vector<char> node(makeNode(gen, 20));
+        const std::vector<char> plain(
+            zstd::compress(node.data(), node.size()));
+        const std::vector<char> compressed(
+            zstd::compress(node.data(), node.size(), options));
+        plainBytes += plain.size();
+        dictionaryBytes += compressed.size();
+
+        EXPECT_NE(
+            zstd::dictionaryId(compressed.data(), compressed.size()),
+            0u);
+        EXPECT_EQ(
+            zstd::decompress(compressed, node.size(), &dictionary),
+            node);
+
+        // Frames compressed with a dictionary can't be read without it, and
+        // frames compressed without one ignore it.
+        EXPECT_ANY_THROW(zstd::decompress(compressed, node.size()));
+        EXPECT_EQ(zstd::decompress(plain, node.size(), &dictionary), node);
+    }
+    EXPECT_LT(dictionaryBytes, plainBytes);
+}
+
+TEST(zstd, insufficientSamples)
+{
+    // Too few samples to train from yields no dictionary, rather than an
+    // error, and nodes are then compressed without one.
+    const Samples samples(makeSamples(2, 1));
+    EXPECT_TRUE(
+        zstd::Dictionary::train(samples.data, samples.sizes, capacity)
+            .empty());
+
+    EXPECT_TRUE(zstd::Dictionary::train({ }, { }, capacity).empty());
+}